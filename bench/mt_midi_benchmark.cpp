@@ -0,0 +1,383 @@
+#include "mt_midi_benchmark.hpp"
+#include "mt_midi_file.hpp"
+#include "mt_midi_stream_parser.hpp"
+#include "mt_smf_file.hpp"
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+using namespace godot;
+
+namespace {
+
+const int32_t TRACK_COUNT = 16;
+
+// Appends big-endian values and variable length values to the generated file
+struct SmfWriter {
+    PackedByteArray bytes;
+
+    void u8(uint8_t value) { bytes.push_back(value); }
+    void u16(uint16_t value) { u8(value >> 8); u8(value & 0xFF); }
+    void u32(uint32_t value) { u16(value >> 16); u16(value & 0xFFFF); }
+    void vlv(uint32_t value)
+    {
+        uint8_t buffer[4];
+        int32_t length = MTMidiMsg::store_variable_length(value, buffer);
+        for (int32_t i = 0; i < length; ++i)
+        {
+            u8(buffer[i]);
+        }
+    }
+    void text(uint32_t delta, uint8_t type, const char *value)
+    {
+        int32_t length = strlen(value);
+        vlv(delta);
+        u8(0xFF);
+        u8(type);
+        vlv(length);
+        for (int32_t i = 0; i < length; ++i)
+        {
+            u8(value[i]);
+        }
+    }
+    int64_t begin_track()
+    {
+        u32(0x4D54726B);
+        u32(0);
+        return bytes.size();
+    }
+    void end_track(int64_t start)
+    {
+        vlv(0);
+        u8(0xFF);
+        u8(0x2F);
+        u8(0);
+        uint32_t length = bytes.size() - start;
+        for (int32_t i = 0; i < 4; ++i)
+        {
+            bytes.set(start - 4 + i, (length >> (24 - i * 8)) & 0xFF);
+        }
+    }
+};
+
+struct Measurement {
+    Vector<uint64_t> usecs;
+    int64_t memory_bytes = 0;
+    int64_t peak_increase = 0;
+    bool ok = true;
+};
+
+// Runs setup() untimed, work() timed and teardown() untimed per iteration.
+// Memory in use is sampled after work(), before teardown() releases it.
+template <typename Setup, typename Work, typename Teardown>
+Measurement measure(int32_t iterations, Setup setup, Work work, Teardown teardown)
+{
+    Measurement result;
+    OS *os = OS::get_singleton();
+    Time *time = Time::get_singleton();
+    uint64_t peak_before = os->get_static_memory_peak_usage();
+    for (int32_t i = 0; (i < iterations) && result.ok; ++i)
+    {
+        setup();
+        uint64_t memory_before = os->get_static_memory_usage();
+        uint64_t start = time->get_ticks_usec();
+        result.ok = work();
+        result.usecs.push_back(time->get_ticks_usec() - start);
+        result.memory_bytes = (int64_t)os->get_static_memory_usage() - (int64_t)memory_before;
+        teardown();
+    }
+    result.peak_increase = (int64_t)os->get_static_memory_peak_usage() - (int64_t)peak_before;
+    result.usecs.sort();
+    return result;
+}
+
+}
+
+void MTMidiBenchmark::_bind_methods()
+{
+	ClassDB::bind_static_method("MTMidiBenchmark", D_METHOD("generate_smf", "track_count", "notes_per_track", "seed"), &MTMidiBenchmark::generate_smf);
+	ClassDB::bind_method(D_METHOD("run", "note_counts", "iterations", "work_dir", "cases"), &MTMidiBenchmark::run, DEFVAL(PackedStringArray()));
+}
+
+/// @brief Generates a format 1 file with a conductor track and note tracks
+/// Note tracks use running status and Note On velocity 0 for note ends, with
+/// a controller every 8 notes and a pitch bend every 16, like typical
+/// sequencer output.  The same seed always gives the same file.
+/// @param track_count int32_t, number of tracks including the conductor track
+/// @param notes_per_track int32_t, notes in each note track
+/// @param seed int32_t, seed of the note values, lengths and velocities
+/// @return PackedByteArray, contents of the file
+PackedByteArray MTMidiBenchmark::generate_smf(int32_t track_count, int32_t notes_per_track, int32_t seed)
+{
+    track_count = track_count > 1 ? (track_count < 0xFFFF ? track_count : 0xFFFF) : 2;
+    uint32_t random = seed != 0 ? seed : 1;
+    auto next_random = [&random](uint32_t range)
+    {
+        random = random * 1664525 + 1013904223;
+        return (random >> 8) % range;
+    };
+
+    SmfWriter writer;
+    writer.u32(0x4D546864);
+    writer.u32(6);
+    writer.u16(1);
+    writer.u16(track_count);
+    writer.u16(480);
+
+    // Conductor track, tempo changes every 16 bars
+    int64_t start = writer.begin_track();
+    writer.text(0, 0x03, "Conductor");
+    writer.vlv(0);
+    writer.u8(0xFF); writer.u8(0x58); writer.u8(4);
+    writer.u8(4); writer.u8(2); writer.u8(24); writer.u8(8);
+    uint32_t song_ticks = notes_per_track * 240;
+    for (uint32_t tick = 0; tick < song_ticks; tick += 480 * 64)
+    {
+        uint32_t tempo = 400000 + next_random(200000);
+        writer.vlv(tick > 0 ? 480 * 64 : 0);
+        writer.u8(0xFF); writer.u8(0x51); writer.u8(3);
+        writer.u8(tempo >> 16); writer.u8((tempo >> 8) & 0xFF); writer.u8(tempo & 0xFF);
+    }
+    writer.end_track(start);
+
+    for (int32_t track = 1; track < track_count; ++track)
+    {
+        uint8_t channel = (track - 1) % 16;
+        start = writer.begin_track();
+        writer.text(0, 0x03, "Track");
+        writer.vlv(0);
+        writer.u8(0xC0 | channel);
+        writer.u8(next_random(128));
+
+        // Eighth notes one after another, with random steps between them
+        uint8_t note = 48 + next_random(24);
+        for (int32_t i = 0; i < notes_per_track; ++i)
+        {
+            if ((i % 8) == 0)
+            {
+                writer.vlv(0);
+                writer.u8(0xB0 | channel);
+                writer.u8(next_random(2) ? 7 : 11);
+                writer.u8(next_random(128));
+            }
+            if ((i % 16) == 0)
+            {
+                uint16_t bend = next_random(0x4000);
+                writer.vlv(0);
+                writer.u8(0xE0 | channel);
+                writer.u8(bend & 0x7F);
+                writer.u8(bend >> 7);
+            }
+
+            note = 36 + (note + next_random(13) + 54) % 60;
+            writer.vlv(0);
+            writer.u8(0x90 | channel);
+            writer.u8(note);
+            writer.u8(1 + next_random(127));
+            writer.vlv(240);
+            writer.u8(note);        // Running status Note On, velocity 0
+            writer.u8(0);
+        }
+        writer.end_track(start);
+    }
+    return writer.bytes;
+}
+
+/// @brief Runs the benchmark cases for a number of file sizes
+/// Each size is a generated file of 16 tracks, saved to 'work_dir' for the
+/// cases reading from a file.  Cases:
+///   "read_file": MTMidiFile.read_file()
+///   "read_track": MTMidiTrack::read_track() for all tracks, on an open stream
+///   "parse_bytes": MTMidiStreamParser on the file contents
+///   "core_read": mtcore::SmfFile::read() on the file contents, without Godot types
+///   "core_write": mtcore::SmfFile::write() into memory
+///   "write_file": MTMidiFile.write_file()
+///   "update_meta_data": MTMidiTrack::update_meta_data() for all tracks
+/// Every result is a Dictionary with "case", "notes_per_track", "file_bytes",
+/// "events", "iterations", "usec_min", "usec_median", "mb_per_sec" and
+/// "events_per_sec" (from the fastest run), "memory_bytes" (static memory
+/// still in use after the case, before it is released), "peak_increase"
+/// (rise of the static memory peak) and "ok".  Memory is only tracked by
+/// debug builds of the engine.
+/// @param note_counts PackedInt32Array, notes per track of each file size
+/// @param iterations int32_t, runs per case and size
+/// @param work_dir String, directory for the generated files
+/// @param cases PackedStringArray, cases to run, all when empty
+/// @return Array of Dictionary, one per case and size
+Array MTMidiBenchmark::run(
+    const PackedInt32Array &note_counts,
+    int32_t iterations,
+    const String &work_dir,
+    const PackedStringArray &cases)
+{
+    Array results;
+    iterations = iterations > 0 ? iterations : 1;
+    if (DirAccess::make_dir_recursive_absolute(work_dir) != Error::OK)
+    {
+        WARN_PRINT_ED(vformat("Could not create benchmark directory: %s", work_dir));
+        return results;
+    }
+
+    for (int64_t size_index = 0; size_index < note_counts.size(); ++size_index)
+    {
+        int32_t notes = note_counts[size_index];
+        PackedByteArray bytes = generate_smf(TRACK_COUNT, notes, notes);
+        String path = work_dir.path_join(vformat("bench_%d.mid", notes));
+        String out_path = work_dir.path_join(vformat("bench_%d_out.mid", notes));
+        Ref<FileAccess> out = FileAccess::open(path, FileAccess::ModeFlags::WRITE);
+        if (out.is_null())
+        {
+            WARN_PRINT_ED(vformat("Could not write benchmark file: %s", path));
+            continue;
+        }
+        out->store_buffer(bytes);
+        out->close();
+
+        // Reference copy of the file for the cases working on a loaded file,
+        // read without going through the cases being measured
+        Ref<MTMidiFile> loaded;
+        loaded.instantiate();
+        Ref<MTMidiStreamParser> parser;
+        parser.instantiate();
+        parser->begin(loaded);
+        parser->feed(bytes);
+        bool parsed = parser->finish();
+        parser.unref();
+        int64_t events = 0;
+        for (const KeyValue<uint32_t, MTMidiTrack*> &element : loaded->tracks)
+        {
+            events += element.value->get_event_count();
+        }
+
+        Ref<MTMidiFile> file;
+        MTMidiArena arena;
+        MTMidiFileStream *stream = nullptr;
+        Vector<MTMidiTrack*> tracks;
+
+        auto nothing = []() {};
+        auto new_file = [&file]() { file.instantiate(); };
+        auto free_file = [&file]() { file.unref(); };
+
+        HashMap<String, Measurement> measured;
+        auto wanted = [&cases](const char *name) { return cases.is_empty() || cases.has(name); };
+
+        if (wanted("read_file"))
+        {
+            measured.insert("read_file", measure(iterations, new_file,
+                [&]() { return file->read_file(path); }, free_file));
+        }
+        if (wanted("read_track"))
+        {
+            measured.insert("read_track", measure(iterations,
+                [&]()
+                {
+                    stream = memnew(MTMidiFileStream);
+                    PackedByteArray header;
+                    stream->open_to_read(path);
+                    stream->read_bytes(14, header);
+                },
+                [&]()
+                {
+                    for (int32_t i = 0; i < TRACK_COUNT; ++i)
+                    {
+                        Error result;
+                        MTMidiTrack *track = MTMidiTrack::read_track(*stream, i, &arena, result);
+                        if (track == nullptr)
+                        {
+                            return false;
+                        }
+                        tracks.push_back(track);
+                    }
+                    return true;
+                },
+                [&]()
+                {
+                    for (MTMidiTrack *track : tracks)
+                    {
+                        memdelete(track);
+                    }
+                    tracks.clear();
+                    arena.clear();
+                    memdelete(stream);
+                    stream = nullptr;
+                }));
+        }
+        if (wanted("parse_bytes"))
+        {
+            measured.insert("parse_bytes", measure(iterations, new_file,
+                [&]()
+                {
+                    Ref<MTMidiStreamParser> bytes_parser;
+                    bytes_parser.instantiate();
+                    bytes_parser->begin(file);
+                    bytes_parser->feed(bytes);
+                    return bytes_parser->finish();
+                }, free_file));
+        }
+        if (wanted("core_read"))
+        {
+            measured.insert("core_read", measure(iterations, nothing,
+                [&]()
+                {
+                    mtcore::SmfFile smf;
+                    return smf.read(bytes.ptr(), bytes.size()) == mtcore::SmfResult::Ok;
+                }, nothing));
+        }
+        if (wanted("core_write"))
+        {
+            mtcore::SmfFile smf;
+            smf.read(bytes.ptr(), bytes.size());
+            measured.insert("core_write", measure(iterations, nothing,
+                [&]()
+                {
+                    std::vector<uint8_t> contents;
+                    return smf.write(contents) == mtcore::SmfResult::Ok;
+                }, nothing));
+        }
+        if (wanted("write_file") && parsed)
+        {
+            measured.insert("write_file", measure(iterations, nothing,
+                [&]() { return loaded->write_file(out_path, true); }, nothing));
+        }
+        if (wanted("update_meta_data") && parsed)
+        {
+            measured.insert("update_meta_data", measure(iterations, nothing,
+                [&]()
+                {
+                    for (const KeyValue<uint32_t, MTMidiTrack*> &element : loaded->tracks)
+                    {
+                        element.value->update_meta_data();
+                    }
+                    return true;
+                }, nothing));
+        }
+
+        for (const KeyValue<String, Measurement> &element : measured)
+        {
+            const Measurement &m = element.value;
+            uint64_t fastest = m.usecs.is_empty() ? 0 : m.usecs[0];
+            double seconds = fastest > 0 ? fastest / 1000000.0 : 0.000001;
+
+            Dictionary result;
+            result["case"] = element.key;
+            result["notes_per_track"] = notes;
+            result["file_bytes"] = bytes.size();
+            result["events"] = events;
+            result["iterations"] = m.usecs.size();
+            result["usec_min"] = fastest;
+            result["usec_median"] = m.usecs.is_empty() ? 0 : m.usecs[m.usecs.size() / 2];
+            result["mb_per_sec"] = bytes.size() / seconds / (1024.0 * 1024.0);
+            result["events_per_sec"] = events / seconds;
+            result["memory_bytes"] = m.memory_bytes;
+            result["peak_increase"] = m.peak_increase;
+            result["ok"] = m.ok;
+            results.push_back(result);
+        }
+
+        DirAccess::remove_absolute(path);
+        DirAccess::remove_absolute(out_path);
+    }
+    return results;
+}
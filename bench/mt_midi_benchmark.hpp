@@ -0,0 +1,29 @@
+#ifndef MT_MIDI_BENCHMARK_H
+#define MT_MIDI_BENCHMARK_H
+
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+
+namespace godot {
+
+// Benchmarks of the MIDI file pipeline on synthetic files, only built with
+// 'scons benchmarks=yes'.  Driven by bench/run_benchmarks.gd in a headless
+// Godot instance, as godot-cpp types need a running engine.
+class MTMidiBenchmark : public Node {
+    GDCLASS(MTMidiBenchmark, Node)
+
+    protected:
+    static void _bind_methods();
+
+    public:
+    static PackedByteArray generate_smf(int32_t track_count, int32_t notes_per_track, int32_t seed);
+    Array run(const PackedInt32Array &note_counts, int32_t iterations, const String &work_dir,
+              const PackedStringArray &cases);
+};
+
+}
+#endif
@@ -0,0 +1,274 @@
+#include "mt_synth_benchmark.hpp"
+#include "mt_midi_benchmark.hpp"
+#include "mt_fluid_synth_node.hpp"
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+#include <fluidsynth.h>
+
+using namespace godot;
+
+namespace {
+
+// Block time at a percentile of the sorted block times
+uint64_t percentile(const Vector<uint64_t> &sorted, int32_t percent)
+{
+    if (sorted.is_empty())
+    {
+        return 0;
+    }
+    int64_t index = sorted.size() * percent / 100;
+    return sorted[index < sorted.size() ? index : sorted.size() - 1];
+}
+
+// FluidSynth objects of one benchmark run, deleted in reverse order
+struct SynthRun {
+    fluid_settings_t *settings = nullptr;
+    fluid_synth_t *synth = nullptr;
+    fluid_player_t *player = nullptr;
+    fluid_file_renderer_t *renderer = nullptr;
+
+    ~SynthRun()
+    {
+        if (player != nullptr)
+        {
+            fluid_player_stop(player);
+            fluid_player_join(player);
+            delete_fluid_player(player);
+        }
+        if (renderer != nullptr)
+        {
+            delete_fluid_file_renderer(renderer);
+        }
+        if (synth != nullptr)
+        {
+            delete_fluid_synth(synth);
+        }
+        if (settings != nullptr)
+        {
+            delete_fluid_settings(settings);
+        }
+    }
+};
+
+}
+
+void MTSynthBenchmark::_bind_methods()
+{
+	ClassDB::bind_static_method("MTSynthBenchmark", D_METHOD("get_default_config"), &MTSynthBenchmark::get_default_config);
+	ClassDB::bind_method(D_METHOD("run", "sf_path", "configs", "seconds", "work_dir"), &MTSynthBenchmark::run, DEFVAL(Array()), DEFVAL(30.0), DEFVAL(String()));
+}
+
+/// @brief Returns the configuration that run() starts every config from
+/// Keys:
+///   "polyphony": synth.polyphony
+///   "interpolation": as MTFluidSynthNode.synth_set_interpolation()
+///   "sample_rate": synth.sample-rate
+///   "reverb", "chorus": synth.reverb.active and synth.chorus.active
+///   "cpu_cores": synth.cpu-cores
+///   "period_size": frames rendered per block, audio.period-size
+///   "tracks": note tracks of the event stream, 16 play one note per channel
+///   "output": "null" renders into memory, "file" through the file driver
+/// @return Dictionary, default configuration
+Dictionary MTSynthBenchmark::get_default_config()
+{
+    Dictionary config;
+    config["polyphony"] = 256;
+    config["interpolation"] = 2;
+    config["sample_rate"] = 44100.0;
+    config["reverb"] = true;
+    config["chorus"] = true;
+    config["cpu_cores"] = 1;
+    config["period_size"] = 512;
+    config["tracks"] = 64;
+    config["output"] = "null";
+    return config;
+}
+
+/// @brief Renders a fixed event stream once per synth configuration
+/// The stream is a file of MTMidiBenchmark.generate_smf() played by a
+/// FluidSynth player on sample timing, so every configuration gets the same
+/// events at the same audio positions.  Blocks are rendered as fast as
+/// possible without an audio device, either into memory or through the file
+/// renderer, and each block is timed.
+/// Every result is a Dictionary with "config" (the complete configuration),
+/// "blocks", "audio_seconds", "render_seconds", "realtime_factor" (render
+/// time / audio time, below 1.0 is faster than real time), "block_budget_usec"
+/// (audio time of one block), "block_usec_p50", "block_usec_p90",
+/// "block_usec_p99", "block_usec_max", "overruns" (blocks slower than their
+/// budget), "peak_voices" and "ok".
+/// @param sf_path String, path of the SoundFont to render with
+/// @param configs Array of Dictionary, changes to the default configuration,
+///                the default configuration alone when empty
+/// @param seconds double, audio time rendered per configuration
+/// @param work_dir String, directory for the "file" output, the user data
+///                 directory when empty
+/// @return Array of Dictionary, one per configuration
+Array MTSynthBenchmark::run(const String &sf_path, const Array &configs, double seconds, const String &work_dir)
+{
+    Array results;
+    seconds = seconds > 0.0 ? seconds : 1.0;
+    String output_dir = work_dir.is_empty() ? OS::get_singleton()->get_user_data_dir() : work_dir;
+    if (DirAccess::make_dir_recursive_absolute(output_dir) != Error::OK)
+    {
+        WARN_PRINT_ED(vformat("Could not create benchmark directory: %s", output_dir));
+        return results;
+    }
+    String output_path = output_dir.path_join("synth_benchmark.wav");
+
+    Array runs = configs;
+    if (runs.is_empty())
+    {
+        runs.push_back(Dictionary());
+    }
+
+    // Notes are eighths at about 120 bpm, longer than the rendered time
+    int32_t notes_per_track = (int32_t)(seconds * 4.0) + 16;
+    Time *time = Time::get_singleton();
+
+    for (int64_t run_index = 0; run_index < runs.size(); ++run_index)
+    {
+        Dictionary config = get_default_config();
+        config.merge(runs[run_index], true);
+        Dictionary result;
+        result["config"] = config;
+        result["ok"] = false;
+        results.push_back(result);
+
+        int32_t tracks = config["tracks"];
+        int32_t period_size = config["period_size"];
+        bool to_file = String(config["output"]) == "file";
+        if ((tracks < 1) || (period_size < 1))
+        {
+            WARN_PRINT_ED("Benchmark tracks and period size must be positive");
+            continue;
+        }
+        PackedByteArray smf = MTMidiBenchmark::generate_smf(tracks + 1, notes_per_track, 1);
+
+        SynthRun synth_run;
+        synth_run.settings = new_fluid_settings();
+        fluid_settings_t *settings = synth_run.settings;
+        bool settings_ok =
+            (fluid_settings_setint(settings, "synth.polyphony", config["polyphony"]) == FLUID_OK) &&
+            (fluid_settings_setnum(settings, "synth.sample-rate", config["sample_rate"]) == FLUID_OK) &&
+            (fluid_settings_setint(settings, "synth.reverb.active", (bool)config["reverb"] ? 1 : 0) == FLUID_OK) &&
+            (fluid_settings_setint(settings, "synth.chorus.active", (bool)config["chorus"] ? 1 : 0) == FLUID_OK) &&
+            (fluid_settings_setint(settings, "synth.cpu-cores", config["cpu_cores"]) == FLUID_OK) &&
+            (fluid_settings_setint(settings, "audio.period-size", period_size) == FLUID_OK) &&
+            (fluid_settings_setstr(settings, "player.timing-source", "sample") == FLUID_OK) &&
+            (fluid_settings_setint(settings, "synth.lock-memory", 0) == FLUID_OK) &&
+            (!to_file || (fluid_settings_setstr(settings, "audio.file.name", output_path.utf8().get_data()) == FLUID_OK));
+        if (!settings_ok)
+        {
+            WARN_PRINT_ED(vformat("Invalid benchmark configuration: %s", config));
+            continue;
+        }
+
+        synth_run.synth = new_fluid_synth(settings);
+        if (synth_run.synth == nullptr)
+        {
+            WARN_PRINT_ED("Failed to create FluidSynth");
+            continue;
+        }
+        fluid_synth_t *synth = synth_run.synth;
+        if (fluid_synth_sfload(synth, sf_path.utf8().get_data(), 1) == FLUID_FAILED)
+        {
+            WARN_PRINT_ED(vformat("Failed to load SoundFont: %s", sf_path));
+            continue;
+        }
+        if (fluid_synth_set_interp_method(synth, -1, MTFluidSynthNode::get_interp_method(config["interpolation"])) == FLUID_FAILED)
+        {
+            WARN_PRINT_ED("Failed to set interpolation method");
+            continue;
+        }
+
+        synth_run.player = new_fluid_player(synth);
+        if ((synth_run.player == nullptr) ||
+            (fluid_player_add_mem(synth_run.player, smf.ptr(), smf.size()) == FLUID_FAILED))
+        {
+            WARN_PRINT_ED("Failed to load the benchmark events");
+            continue;
+        }
+        fluid_player_set_loop(synth_run.player, -1);
+        fluid_player_play(synth_run.player);
+
+        if (to_file)
+        {
+            synth_run.renderer = new_fluid_file_renderer(synth);
+            if (synth_run.renderer == nullptr)
+            {
+                WARN_PRINT_ED(vformat("Failed to create file renderer: %s", output_path));
+                continue;
+            }
+        }
+
+        // The synth may have limited the sample rate
+        double sample_rate = 44100.0;
+        fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
+        int64_t total_frames = (int64_t)(seconds * sample_rate);
+        int64_t block_count = (total_frames + period_size - 1) / period_size;
+
+        Vector<float> left;
+        Vector<float> right;
+        left.resize(period_size);
+        right.resize(period_size);
+        float *left_ptr = left.ptrw();
+        float *right_ptr = right.ptrw();
+
+        Vector<uint64_t> block_usecs;
+        block_usecs.resize(block_count);
+        uint64_t *block_ptr = block_usecs.ptrw();
+        uint64_t render_usec = 0;
+        int32_t peak_voices = 0;
+        bool rendered = true;
+        for (int64_t block = 0; (block < block_count) && rendered; ++block)
+        {
+            uint64_t start = time->get_ticks_usec();
+            if (synth_run.renderer != nullptr)
+            {
+                rendered = fluid_file_renderer_process_block(synth_run.renderer) == FLUID_OK;
+            }
+            else
+            {
+                rendered = fluid_synth_write_float(synth, period_size, left_ptr, 0, 1, right_ptr, 0, 1) == FLUID_OK;
+            }
+            block_ptr[block] = time->get_ticks_usec() - start;
+            render_usec += block_ptr[block];
+
+            int32_t voices = fluid_synth_get_active_voice_count(synth);
+            peak_voices = voices > peak_voices ? voices : peak_voices;
+        }
+        if (!rendered)
+        {
+            WARN_PRINT_ED("FluidSynth failed to render a block");
+            continue;
+        }
+        block_usecs.sort();
+
+        double audio_seconds = (double)(block_count * period_size) / sample_rate;
+        double render_seconds = render_usec / 1000000.0;
+        uint64_t budget = (uint64_t)(period_size * 1000000.0 / sample_rate);
+        int64_t overruns = 0;
+        for (int64_t i = block_count - 1; (i >= 0) && (block_ptr[i] > budget); --i)
+        {
+            ++overruns;
+        }
+
+        result["blocks"] = block_count;
+        result["audio_seconds"] = audio_seconds;
+        result["render_seconds"] = render_seconds;
+        result["realtime_factor"] = audio_seconds > 0.0 ? render_seconds / audio_seconds : 0.0;
+        result["block_budget_usec"] = budget;
+        result["block_usec_p50"] = percentile(block_usecs, 50);
+        result["block_usec_p90"] = percentile(block_usecs, 90);
+        result["block_usec_p99"] = percentile(block_usecs, 99);
+        result["block_usec_max"] = block_usecs.is_empty() ? 0 : block_usecs[block_count - 1];
+        result["overruns"] = overruns;
+        result["peak_voices"] = peak_voices;
+        result["ok"] = true;
+    }
+
+    DirAccess::remove_absolute(output_path);
+    return results;
+}
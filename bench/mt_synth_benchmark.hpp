@@ -0,0 +1,25 @@
+#ifndef MT_SYNTH_BENCHMARK_H
+#define MT_SYNTH_BENCHMARK_H
+
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+
+namespace godot {
+
+// Benchmarks of FluidSynth rendering per synth configuration, only built
+// with 'scons benchmarks=yes'.  Driven by bench/run_synth_benchmarks.gd in a
+// headless Godot instance.
+class MTSynthBenchmark : public Node {
+    GDCLASS(MTSynthBenchmark, Node)
+
+    protected:
+    static void _bind_methods();
+
+    public:
+    static Dictionary get_default_config();
+    Array run(const String &sf_path, const Array &configs, double seconds, const String &work_dir);
+};
+
+}
+#endif
@@ -0,0 +1,51 @@
+# Runs the MIDI file pipeline benchmarks of a library built with
+# 'scons benchmarks=yes', in a project that loads the extension:
+#
+#   godot --headless --path <project> -s <path>/run_benchmarks.gd -- [options]
+#
+# Options:
+#   --sizes=1000,10000,100000   notes per track of each generated file
+#   --iterations=10             runs per case and size
+#   --cases=read_file,...       cases to run, all by default
+#   --output=<path>             also write the results as JSON
+extends SceneTree
+
+func _init() -> void:
+	var sizes := PackedInt32Array([1000, 10000, 100000])
+	var iterations := 10
+	var cases := PackedStringArray()
+	var output := ""
+	for arg in OS.get_cmdline_user_args():
+		var parts := arg.trim_prefix("--").split("=", true, 1)
+		var value := parts[1] if parts.size() > 1 else ""
+		match parts[0]:
+			"sizes":
+				sizes = PackedInt32Array(Array(value.split(",")).map(func(v): return int(v)))
+			"iterations":
+				iterations = int(value)
+			"cases":
+				cases = value.split(",")
+			"output":
+				output = value
+
+	if not ClassDB.class_exists("MTMidiBenchmark"):
+		printerr("MTMidiBenchmark not found, build the library with 'scons benchmarks=yes'")
+		quit(1)
+		return
+
+	var benchmark = ClassDB.instantiate("MTMidiBenchmark")
+	var results: Array = benchmark.run(sizes, iterations, OS.get_user_data_dir().path_join("midi_benchmark"), cases)
+	benchmark.free()
+
+	print("%-24s %8s %10s %10s %10s %10s %12s %12s %4s" % ["case", "notes", "bytes", "min us", "median us", "MB/s", "events/s", "memory", "ok"])
+	for r in results:
+		print("%-24s %8d %10d %10d %10d %10.1f %12.0f %12d %4s" % [r.case, r.notes_per_track, r.file_bytes,
+			r.usec_min, r.usec_median, r.mb_per_sec, r.events_per_sec, r.memory_bytes, "yes" if r.ok else "NO"])
+
+	if output != "":
+		var file := FileAccess.open(output, FileAccess.WRITE)
+		if file == null:
+			printerr("Could not write %s" % output)
+		else:
+			file.store_string(JSON.stringify({"engine": Engine.get_version_info(), "results": results}, "  "))
+	quit(0 if results.all(func(r): return r.ok) else 1)
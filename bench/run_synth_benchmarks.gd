@@ -0,0 +1,89 @@
+# Runs the synth rendering benchmarks of a library built with
+# 'scons benchmarks=yes', in a project that loads the extension:
+#
+#   godot --headless --path <project> -s <path>/run_synth_benchmarks.gd -- --soundfont=<sf2> [options]
+#
+# Starting from MTSynthBenchmark.get_default_config(), each setting below is
+# varied on its own, so every row differs from the first in one setting.
+#
+# Options:
+#   --soundfont=<path>          SoundFont to render with, required
+#   --seconds=30                audio time rendered per configuration
+#   --polyphony=64,128,256      values of each setting to try
+#   --interpolation=0,1,2,3
+#   --sample_rate=22050,44100,48000
+#   --effects=on,off            reverb and chorus together
+#   --cpu_cores=1,2,4
+#   --period_size=64,256,512
+#   --output=null,file
+#   --json=<path>               also write the results as JSON
+extends SceneTree
+
+func _init() -> void:
+	var soundfont := ""
+	var seconds := 30.0
+	var json := ""
+	var sweeps := {
+		"polyphony": [64, 128, 256],
+		"interpolation": [0, 1, 2, 3],
+		"sample_rate": [22050.0, 44100.0, 48000.0],
+		"effects": [true, false],
+		"cpu_cores": [1, 2, 4],
+		"period_size": [64, 256, 512],
+		"output": ["null", "file"],
+	}
+	for arg in OS.get_cmdline_user_args():
+		var parts := arg.trim_prefix("--").split("=", true, 1)
+		var value := parts[1] if parts.size() > 1 else ""
+		match parts[0]:
+			"soundfont":
+				soundfont = value
+			"seconds":
+				seconds = float(value)
+			"json":
+				json = value
+			"effects":
+				sweeps.effects = Array(value.split(",")).map(func(v): return v == "on")
+			"output":
+				sweeps.output = Array(value.split(","))
+			var setting when sweeps.has(setting):
+				sweeps[setting] = Array(value.split(",")).map(func(v): return float(v) if setting == "sample_rate" else int(v))
+
+	if soundfont == "":
+		printerr("Pass the SoundFont to render with as --soundfont=<path>")
+		quit(1)
+		return
+	if not ClassDB.class_exists("MTSynthBenchmark"):
+		printerr("MTSynthBenchmark not found, build the library with 'scons benchmarks=yes'")
+		quit(1)
+		return
+
+	var benchmark = ClassDB.instantiate("MTSynthBenchmark")
+	var defaults: Dictionary = benchmark.get_default_config()
+	var configs := [{}]
+	for setting in sweeps:
+		for value in sweeps[setting]:
+			var config := {"reverb": value, "chorus": value} if setting == "effects" else {setting: value}
+			if config.keys().any(func(key): return defaults[key] != config[key]):
+				configs.append(config)
+
+	var results: Array = benchmark.run(soundfont, configs, seconds, OS.get_user_data_dir().path_join("synth_benchmark"))
+	benchmark.free()
+
+	print("%-32s %8s %8s %8s %8s %8s %8s %8s %6s %4s" % ["change", "rtf", "budget", "p50 us", "p90 us", "p99 us", "max us", "overrun", "voices", "ok"])
+	for i in results.size():
+		var r: Dictionary = results[i]
+		var change := "default" if configs[i].is_empty() else ", ".join(configs[i].keys().map(func(key): return "%s=%s" % [key, configs[i][key]]))
+		if not r.ok:
+			print("%-32s %8s" % [change, "failed"])
+			continue
+		print("%-32s %8.3f %8d %8d %8d %8d %8d %8d %6d %4s" % [change, r.realtime_factor, r.block_budget_usec,
+			r.block_usec_p50, r.block_usec_p90, r.block_usec_p99, r.block_usec_max, r.overruns, r.peak_voices, "yes"])
+
+	if json != "":
+		var file := FileAccess.open(json, FileAccess.WRITE)
+		if file == null:
+			printerr("Could not write %s" % json)
+		else:
+			file.store_string(JSON.stringify({"engine": Engine.get_version_info(), "soundfont": soundfont, "seconds": seconds, "results": results}, "  "))
+	quit(0 if results.all(func(r): return r.ok) else 1)
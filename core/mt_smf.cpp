@@ -0,0 +1,295 @@
+#include "mt_smf.hpp"
+#include <cstring>
+
+namespace mtcore {
+
+/// @brief Decodes a variable length value without consuming any data
+/// @param data Pointer to the first byte of the value
+/// @param available uint64_t, number of bytes available at 'data'
+/// @param value uint32_t receiving the decoded value
+/// @return int32_t, length of the value in bytes, 0 if more data is needed,
+///         -1 if the value is longer than 4 bytes
+int32_t peek_variable_length(const uint8_t *data, uint64_t available, uint32_t &value)
+{
+    value = 0;
+    for (uint64_t i = 0; (i < available) && (i < 4); ++i)
+    {
+        value = (value << 7) | (data[i] & 0x7F);
+        if ((data[i] & 0x80) == 0)
+        {
+            return i + 1;
+        }
+    }
+    return available < 4 ? 0 : -1;
+}
+
+/// @brief Encodes a variable length value
+/// @param value uint32_t, value to encode, at most MAX_VARIABLE_LENGTH
+/// @param data Pointer receiving the value, room for 4 bytes
+/// @return int32_t, length of the value in bytes
+int32_t store_variable_length(uint32_t value, uint8_t *data)
+{
+    int32_t shift = 21;
+    while ((shift > 0) && ((value >> shift) == 0))
+    {
+        shift -= 7;
+    }
+
+    uint8_t *ptr = data;
+    for (; shift > 0; shift -= 7)
+    {
+        *ptr++ = 0x80 | ((value >> shift) & 0x7F);
+    }
+    *ptr++ = value & 0x7F;
+    return ptr - data;
+}
+
+/// @brief Measures a value encoded as variable length value
+/// @param value uint32_t, value to measure
+/// @return int32_t, length in bytes, 5 for values above MAX_VARIABLE_LENGTH,
+///         which can not be stored
+int32_t get_variable_length_size(uint32_t value)
+{
+    if (value < 128) return 1;
+    if (value < 16384) return 2;
+    if (value < 2097152) return 3;
+    if (value < 268435456) return 4;
+    return 5;
+}
+
+/// @brief Measures the message at 'data' without consuming or copying it
+/// @param data Pointer to the status byte, or the first data byte when
+///             running status is in effect
+/// @param available uint64_t, number of bytes available at 'data'
+/// @param running_status uint8_t, status byte of the previous channel message
+/// @return int32_t, length of the message in bytes, 0 if more data is needed,
+///         -1 if the message can not be decoded
+int32_t peek_msg_length(const uint8_t *data, uint64_t available, uint8_t running_status)
+{
+    if (available == 0)
+    {
+        return 0;
+    }
+
+    uint8_t status_byte = running_status;
+    uint64_t offset = 0;
+    if (is_status_byte(data[0]))
+    {
+        status_byte = data[0];
+        offset = 1;
+    }
+
+    uint64_t data_length = 0;
+    switch (status_byte & 0xF0)
+    {
+        case 0x80:      // Note Off
+        case 0x90:      // Note On
+        case 0xA0:      // Poly Key Pressure
+        case 0xB0:      // Control Change
+        case 0xE0:      // Pitch Bend
+            data_length = 2;
+            break;
+        case 0xC0:      // Program Change
+        case 0xD0:      // Channel Pressure
+            data_length = 1;
+            break;
+        case STATUS_NON_CHANNEL:
+            {
+                if (status_byte == STATUS_META)
+                {
+                    // Meta type byte
+                    ++offset;
+                }
+                else if ((status_byte != STATUS_SYSEX) && (status_byte != STATUS_SYSEX_CONTINUE))
+                {
+                    return -1;
+                }
+
+                if (available < offset)
+                {
+                    return 0;
+                }
+
+                uint32_t payload_length;
+                int32_t vl_length = peek_variable_length(data + offset, available - offset, payload_length);
+                if (vl_length <= 0)
+                {
+                    return vl_length;
+                }
+                data_length = vl_length + (uint64_t)payload_length;
+            }
+            break;
+        default:
+            // Data byte without running status
+            return -1;
+    }
+
+    if (offset + data_length > available)
+    {
+        return 0;
+    }
+    return offset + data_length;
+}
+
+/// @brief Measures a message measured by peek_msg_length() once stored by
+/// store_msg()
+/// @param data Pointer to the message as passed to peek_msg_length()
+/// @param length int32_t, length given by peek_msg_length()
+/// @return uint32_t, length of the stored message
+uint32_t get_stored_length(const uint8_t *data, int32_t length)
+{
+    return is_status_byte(data[0]) ? length : length + 1;
+}
+
+/// @brief Copies a message measured by peek_msg_length(), adding the status
+/// byte when running status is used
+/// @param data Pointer to the status byte, or the first data byte when
+///             running status is in effect
+/// @param length int32_t, length given by peek_msg_length()
+/// @param running_status uint8_t, status byte of the previous channel message, updated
+/// @param bytes Pointer receiving the message, room for get_stored_length() bytes
+/// @return uint32_t, length of the stored message
+uint32_t store_msg(const uint8_t *data, int32_t length, uint8_t &running_status, uint8_t *bytes)
+{
+    bool has_status = is_status_byte(data[0]);
+    uint8_t status_byte = has_status ? data[0] : running_status;
+    uint32_t stored_length = has_status ? length : length + 1;
+
+    bytes[0] = status_byte;
+    memcpy(bytes + 1, has_status ? data + 1 : data, stored_length - 1);
+
+    if (status_byte < STATUS_NON_CHANNEL)
+    {
+        running_status = status_byte;
+    }
+    return stored_length;
+}
+
+/// @brief Fills in an event for complete message bytes
+/// Note values and velocities are masked to 7 bits in place.
+/// @param bytes Pointer to the message, starting with its status byte
+/// @param length uint32_t, length of the message
+/// @param channel_prefix uint8_t, current MIDI channel prefix, updated
+/// @param port_prefix uint8_t, current MIDI port prefix, updated
+/// @param event SmfEvent receiving the message, except for its tick
+void init_event(uint8_t *bytes, uint32_t length, uint8_t &channel_prefix, uint8_t &port_prefix, SmfEvent &event)
+{
+    uint8_t status_byte = bytes[0];
+    event.bytes = bytes;
+    event.length = length;
+    event.data_length = 0;
+    event.data_start = 0;
+    event.channel_prefix = 0;
+    event.port_prefix = port_prefix;
+
+    if (status_byte < STATUS_NON_CHANNEL)
+    {
+        channel_prefix = status_byte & 0x0F;
+        if ((status_byte & 0xE0) == STATUS_NOTE_OFF)
+        {
+            bytes[1] &= 0x7F;
+            bytes[2] &= 0x7F;
+        }
+    }
+    else
+    {
+        // Meta messages have a type byte before the length
+        uint32_t offset = status_byte == STATUS_META ? 2 : 1;
+        uint32_t value;
+        event.data_start = offset + peek_variable_length(bytes + offset, length - offset, value);
+        event.data_length = value;
+
+        if (status_byte == STATUS_META)
+        {
+            if ((bytes[1] == META_CHANNEL_PREFIX) && (value > 0))
+            {
+                channel_prefix = bytes[event.data_start];
+            }
+            if ((bytes[1] == META_PORT_PREFIX) && (value > 0))
+            {
+                port_prefix = bytes[event.data_start];
+            }
+            event.channel_prefix = channel_prefix;
+            event.port_prefix = port_prefix;
+        }
+    }
+}
+
+/// @brief Validates a message given as status byte and data, and measures
+/// it as stored in a track
+/// The data holds the data bytes of channel messages, the type followed by
+/// the payload of meta messages, or the payload of sysex messages.
+/// @param status uint8_t, status byte
+/// @param data Pointer to the data
+/// @param length int64_t, length of the data
+/// @return int64_t, length of the stored message, -1 if it is not valid in a track
+int64_t get_encoded_length(uint8_t status, const uint8_t *data, int64_t length)
+{
+    // Data bytes following each channel message status, by high nibble
+    static const int32_t channel_data_lengths[7] = { 2, 2, 2, 2, 1, 1, 2 };
+
+    if (status < STATUS_NOTE_OFF)
+    {
+        return -1;
+    }
+    if (status < STATUS_NON_CHANNEL)
+    {
+        if (length != channel_data_lengths[(status >> 4) - 8])
+        {
+            return -1;
+        }
+        for (int64_t i = 0; i < length; ++i)
+        {
+            if (data[i] >= 0x80)
+            {
+                return -1;
+            }
+        }
+        return 1 + length;
+    }
+    if (status == STATUS_META)
+    {
+        if ((length < 1) || (length - 1 > MAX_VARIABLE_LENGTH))
+        {
+            return -1;
+        }
+        return 2 + get_variable_length_size(length - 1) + (length - 1);
+    }
+    if ((status == STATUS_SYSEX) || (status == STATUS_SYSEX_CONTINUE))
+    {
+        if (length > MAX_VARIABLE_LENGTH)
+        {
+            return -1;
+        }
+        return 1 + get_variable_length_size(length) + length;
+    }
+    return -1;
+}
+
+/// @brief Stores a message validated by get_encoded_length()
+/// @param status uint8_t, status byte
+/// @param data Pointer to the data
+/// @param length uint32_t, length of the data
+/// @param bytes Pointer receiving the message, room for get_encoded_length() bytes
+/// @return uint32_t, length of the stored message
+uint32_t encode_msg(uint8_t status, const uint8_t *data, uint32_t length, uint8_t *bytes)
+{
+    uint8_t *ptr = bytes;
+    *ptr++ = status;
+    if (status == STATUS_META)
+    {
+        *ptr++ = data[0];
+        ++data;
+        --length;
+        ptr += store_variable_length(length, ptr);
+    }
+    else if (status >= STATUS_NON_CHANNEL)
+    {
+        ptr += store_variable_length(length, ptr);
+    }
+    memcpy(ptr, data, length);
+    ptr += length;
+    return ptr - bytes;
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef MT_SMF_H
+#define MT_SMF_H
+
+#include <cstdint>
+
+// Godot-independent Standard MIDI File code, built as the miditools_core
+// static library.  Only depends on the C++ standard library, so it can be
+// used by native tools, benchmarks and fuzzers as well as the extension.
+namespace mtcore {
+
+const uint8_t STATUS_NOTE_OFF = 0x80;
+const uint8_t STATUS_NOTE_ON = 0x90;
+const uint8_t STATUS_NON_CHANNEL = 0xF0;
+const uint8_t STATUS_SYSEX = 0xF0;
+const uint8_t STATUS_SYSEX_CONTINUE = 0xF7;
+const uint8_t STATUS_META = 0xFF;
+
+const uint8_t META_CHANNEL_PREFIX = 0x20;
+const uint8_t META_PORT_PREFIX = 0x21;
+const uint8_t META_END_OF_TRACK = 0x2F;
+const uint8_t META_SET_TEMPO = 0x51;
+
+const uint32_t MAX_VARIABLE_LENGTH = 0x0FFFFFFF;
+
+// Compact form of a message of a track.  'bytes' holds the message as in
+// the file, always starting with its status byte, and is owned by whoever
+// decoded the message.
+struct SmfEvent {
+    uint64_t tick;
+    const uint8_t *bytes;
+    uint32_t length;
+    uint32_t data_length;
+    uint8_t data_start;
+    uint8_t channel_prefix;
+    uint8_t port_prefix;
+
+    bool is_channel_msg() const { return (bytes[0] >= 0x80) && (bytes[0] < 0xF0); }
+    bool is_meta_msg(uint8_t meta_type) const { return (bytes[0] == 0xFF) && (length > 1) && (bytes[1] == meta_type); }
+};
+
+inline bool is_status_byte(uint8_t byte) { return (byte & 0x80) != 0; }
+
+int32_t peek_variable_length(const uint8_t *data, uint64_t available, uint32_t &value);
+int32_t store_variable_length(uint32_t value, uint8_t *data);
+int32_t get_variable_length_size(uint32_t value);
+int32_t peek_msg_length(const uint8_t *data, uint64_t available, uint8_t running_status);
+uint32_t get_stored_length(const uint8_t *data, int32_t length);
+uint32_t store_msg(const uint8_t *data, int32_t length, uint8_t &running_status, uint8_t *bytes);
+void init_event(uint8_t *bytes, uint32_t length, uint8_t &channel_prefix, uint8_t &port_prefix, SmfEvent &event);
+int64_t get_encoded_length(uint8_t status, const uint8_t *data, int64_t length);
+uint32_t encode_msg(uint8_t status, const uint8_t *data, uint32_t length, uint8_t *bytes);
+
+}
+#endif
@@ -0,0 +1,477 @@
+#include "mt_smf_file.hpp"
+#include "mt_smf_scanner.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace mtcore {
+
+namespace {
+
+uint32_t read_u32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+void append_u16(std::vector<uint8_t> &out, uint16_t value)
+{
+    out.push_back(value >> 8);
+    out.push_back(value & 0xFF);
+}
+
+void append_u32(std::vector<uint8_t> &out, uint32_t value)
+{
+    append_u16(out, value >> 16);
+    append_u16(out, value & 0xFFFF);
+}
+
+// Numbers the temporary files of write_file_atomic() within the process
+std::atomic<uint32_t> temp_file_count{ 0 };
+
+// Creates a temporary file next to 'path' with a name no other writer uses,
+// opened for writing.  Returns nullptr when no file could be created.
+FILE *open_temp_file(const std::string &path, std::string &temp_path)
+{
+    for (int attempt = 0; attempt < 16; ++attempt)
+    {
+#ifdef _WIN32
+        temp_path = path + "." + std::to_string(_getpid()) + "." + std::to_string(++temp_file_count) + ".tmp";
+        int fd = _open(temp_path.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+        if (fd >= 0)
+        {
+            FILE *file = _fdopen(fd, "wb");
+            if (file == nullptr)
+            {
+                _close(fd);
+                remove(temp_path.c_str());
+            }
+            return file;
+        }
+#else
+        temp_path = path + "." + std::to_string(getpid()) + "." + std::to_string(++temp_file_count) + ".tmp";
+        // Created with the permissions of a new file, changed below if 'path' exists
+        int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd >= 0)
+        {
+            struct stat original;
+            if ((stat(path.c_str(), &original) == 0) && (fchmod(fd, original.st_mode & 07777) != 0))
+            {
+                close(fd);
+                remove(temp_path.c_str());
+                return nullptr;
+            }
+            FILE *file = fdopen(fd, "wb");
+            if (file == nullptr)
+            {
+                close(fd);
+                remove(temp_path.c_str());
+            }
+            return file;
+        }
+#endif
+        if (errno != EEXIST)
+        {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+/// @brief Describes a result for messages and logs
+/// @param result SmfResult to describe
+/// @return const char*, static text
+const char *get_result_text(SmfResult result)
+{
+    switch (result)
+    {
+        case SmfResult::Ok: return "ok";
+        case SmfResult::CantOpen: return "file could not be opened";
+        case SmfResult::CantWrite: return "file could not be written";
+        case SmfResult::Unrecognized: return "not a standard MIDI file";
+        case SmfResult::InvalidHeader: return "invalid header chunk";
+        case SmfResult::Truncated: return "chunk longer than the file";
+        case SmfResult::InvalidTrack: return "message could not be decoded";
+        case SmfResult::TooLarge: return "value too large for the file format";
+        case SmfResult::LimitExceeded: return "file exceeds the parsing limits";
+    }
+    return "unknown error";
+}
+
+/// @brief Writes a file atomically, see the declaration
+/// The temporary file is named after the path, the process and a counter,
+/// so concurrent saves of the same path do not share it.  It takes the
+/// permissions of the file it replaces and is removed again when writing
+/// fails.
+/// @param path std::string, path of the file
+/// @param data Pointer to the new contents
+/// @param size uint64_t, length of the contents
+/// @return SmfResult, CantOpen or CantWrite on file errors
+SmfResult write_file_atomic(const std::string &path, const uint8_t *data, uint64_t size)
+{
+    std::string temp_path;
+    FILE *file = open_temp_file(path, temp_path);
+    if (file == nullptr)
+    {
+        return SmfResult::CantOpen;
+    }
+
+    bool written = (fwrite(data, 1, size, file) == size) && (fflush(file) == 0);
+#ifdef _WIN32
+    written = written && (_commit(_fileno(file)) == 0);
+#else
+    written = written && (fsync(fileno(file)) == 0);
+#endif
+    written = (fclose(file) == 0) && written;
+
+#ifdef _WIN32
+    written = written && MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    written = written && (rename(temp_path.c_str(), path.c_str()) == 0);
+    if (written)
+    {
+        // Sync the directory too, so the rename itself is durable
+        size_t separator = path.find_last_of('/');
+        std::string dir_path = separator == std::string::npos ? "." : path.substr(0, separator + 1);
+        int dir = open(dir_path.c_str(), O_RDONLY);
+        if (dir >= 0)
+        {
+            fsync(dir);
+            close(dir);
+        }
+    }
+#endif
+
+    if (!written)
+    {
+        remove(temp_path.c_str());
+        return SmfResult::CantWrite;
+    }
+    return SmfResult::Ok;
+}
+
+/// @brief Returns caps for files from untrusted sources
+/// 16 MiB files, 1024 tracks, 4M events and 1 MiB meta or sysex payloads
+/// cover ordinary music files with a wide margin.
+/// @return SmfLimits, strict caps
+SmfLimits SmfLimits::strict()
+{
+    SmfLimits limits;
+    limits.max_file_size = 16 * 1024 * 1024;
+    limits.max_tracks = 1024;
+    limits.max_events = 4 * 1024 * 1024;
+    limits.max_message_length = 1024 * 1024;
+    return limits;
+}
+
+/// @brief Reserves room for message bytes, in blocks like MTMidiArena
+/// @param size uint64_t, number of bytes
+/// @return uint8_t*, valid until the track is destroyed
+uint8_t *SmfTrack::allocate(uint64_t size)
+{
+    if (size > BLOCK_SIZE / 4)
+    {
+        // Large messages get a block of their own, placed before the current
+        // block so that stays in use
+        auto block = blocks.emplace(blocks.empty() ? blocks.end() : blocks.end() - 1, new uint8_t[size]);
+        return block->get();
+    }
+    if (BLOCK_SIZE - block_used < size)
+    {
+        blocks.emplace_back(new uint8_t[BLOCK_SIZE]);
+        block_used = 0;
+    }
+    uint8_t *ptr = blocks.back().get() + block_used;
+    block_used += size;
+    return ptr;
+}
+
+/// @brief Decodes the data of a track chunk, replacing the messages of the track
+/// @param data Pointer to the data of the chunk, after its header
+/// @param size uint64_t, length of the chunk
+/// @param limits SmfLimits, caps on the message length
+/// @param max_events uint64_t, number of events the track may hold
+/// @return SmfResult, InvalidTrack if a message can not be decoded,
+///         LimitExceeded if a cap is exceeded, the messages before are kept
+SmfResult SmfTrack::read(const uint8_t *data, uint64_t size, const SmfLimits &limits, uint64_t max_events)
+{
+    events.clear();
+    blocks.clear();
+    block_used = BLOCK_SIZE;
+
+    // Stored messages are never longer than the chunk, which also holds
+    // their tick deltas, so one block takes all of them
+    uint8_t *bytes = nullptr;
+    if (size > 0)
+    {
+        blocks.emplace_back(new uint8_t[size]);
+        bytes = blocks.back().get();
+    }
+
+    uint8_t running_status = 0;
+    uint8_t channel_prefix = 0;
+    uint8_t port_prefix = 0;
+    SmfEventScanner scanner(data, size);
+    SmfEventScanner::Event scanned;
+    while (scanner.next(scanned))
+    {
+        if ((scanned.data_length > limits.max_message_length) || (events.size() >= max_events))
+        {
+            return SmfResult::LimitExceeded;
+        }
+
+        SmfEvent event;
+        uint32_t length = store_msg(data + scanned.offset, scanned.length, running_status, bytes);
+        init_event(bytes, length, channel_prefix, port_prefix, event);
+        event.tick = scanned.tick;
+        events.push_back(event);
+        bytes += length;
+    }
+    return scanner.has_error() ? SmfResult::InvalidTrack : SmfResult::Ok;
+}
+
+/// @brief Appends a message given as status byte and data, see get_encoded_length()
+/// The message bytes are copied.  Messages are expected in tick order.
+/// @param tick uint64_t, absolute tick of the message
+/// @param status uint8_t, status byte
+/// @param data Pointer to the data
+/// @param length uint32_t, length of the data
+/// @return bool, false if the message is not valid in a track
+bool SmfTrack::append(uint64_t tick, uint8_t status, const uint8_t *data, uint32_t length)
+{
+    int64_t encoded_length = get_encoded_length(status, data, length);
+    if (encoded_length < 0)
+    {
+        return false;
+    }
+
+    uint8_t channel_prefix = 0;
+    uint8_t port_prefix = 0;
+    for (auto it = events.rbegin(); it != events.rend(); ++it)
+    {
+        if (!it->is_channel_msg())
+        {
+            channel_prefix = it->channel_prefix;
+            port_prefix = it->port_prefix;
+            break;
+        }
+    }
+
+    uint8_t *bytes = allocate(encoded_length);
+    encode_msg(status, data, length, bytes);
+    SmfEvent event;
+    init_event(bytes, encoded_length, channel_prefix, port_prefix, event);
+    event.tick = tick;
+    events.push_back(event);
+    return true;
+}
+
+/// @brief Measures the data of the track chunk, without its header
+/// @return uint64_t, length in bytes
+uint64_t SmfTrack::get_length_in_bytes() const
+{
+    uint64_t length = 0;
+    uint64_t current_tick = 0;
+    for (const SmfEvent &event : events)
+    {
+        length += get_variable_length_size(event.tick - current_tick) + event.length;
+        current_tick = event.tick;
+    }
+    return length;
+}
+
+/// @brief Appends the track as a chunk
+/// Messages are written as stored, without running status.
+/// @param out std::vector receiving the chunk
+/// @return SmfResult, TooLarge if a tick delta or the chunk does not fit the format
+SmfResult SmfTrack::write(std::vector<uint8_t> &out) const
+{
+    uint64_t length = get_length_in_bytes();
+    if (length > 0xFFFFFFFF)
+    {
+        return SmfResult::TooLarge;
+    }
+
+    uint64_t start = out.size();
+    out.resize(start + 8 + length);
+    uint8_t *ptr = out.data() + start;
+    memcpy(ptr, "MTrk", 4);
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        ptr[4 + i] = (length >> (24 - i * 8)) & 0xFF;
+    }
+    ptr += 8;
+
+    uint64_t current_tick = 0;
+    for (const SmfEvent &event : events)
+    {
+        uint64_t delta = event.tick - current_tick;
+        if (delta > MAX_VARIABLE_LENGTH)
+        {
+            out.resize(start);
+            return SmfResult::TooLarge;
+        }
+        ptr += store_variable_length(delta, ptr);
+        memcpy(ptr, event.bytes, event.length);
+        ptr += event.length;
+        current_tick = event.tick;
+    }
+    return SmfResult::Ok;
+}
+
+/// @brief Decodes the contents of a standard MIDI file, replacing all tracks
+/// Every track chunk becomes a track, other chunks are skipped.
+/// @param data Pointer to the contents of the file
+/// @param size uint64_t, length of the contents
+/// @param limits SmfLimits, caps on the data
+/// @return SmfResult, the tracks read before an error are kept
+SmfResult SmfFile::read(const uint8_t *data, uint64_t size, const SmfLimits &limits)
+{
+    tracks.clear();
+    if (size > limits.max_file_size)
+    {
+        return SmfResult::LimitExceeded;
+    }
+    if ((size < 14) || (memcmp(data, "MThd", 4) != 0))
+    {
+        return SmfResult::Unrecognized;
+    }
+
+    uint32_t header_length = read_u32(data + 4);
+    uint64_t offset = 8 + (uint64_t)header_length;
+    if ((header_length < 6) || (offset > size))
+    {
+        return SmfResult::InvalidHeader;
+    }
+    format = (data[8] << 8) | data[9];
+    division = (data[12] << 8) | data[13];
+    uint32_t track_count = (data[10] << 8) | data[11];
+    if (track_count > limits.max_tracks)
+    {
+        return SmfResult::LimitExceeded;
+    }
+    tracks.reserve(track_count);
+
+    uint64_t event_count = 0;
+    while (size - offset >= 8)
+    {
+        const uint8_t *chunk = data + offset;
+        uint32_t chunk_length = read_u32(chunk + 4);
+        offset += 8;
+        if (chunk_length > size - offset)
+        {
+            return SmfResult::Truncated;
+        }
+
+        if (memcmp(chunk, "MTrk", 4) == 0)
+        {
+            if (tracks.size() >= limits.max_tracks)
+            {
+                return SmfResult::LimitExceeded;
+            }
+            tracks.emplace_back();
+            SmfResult result = tracks.back().read(data + offset, chunk_length, limits, limits.max_events - event_count);
+            if (result != SmfResult::Ok)
+            {
+                return result;
+            }
+            event_count += tracks.back().events.size();
+        }
+        offset += chunk_length;
+    }
+    return SmfResult::Ok;
+}
+
+/// @brief Reads a standard MIDI file, see read()
+/// @param path std::string, path of the file
+/// @param limits SmfLimits, caps on the data, a file over max_file_size is
+///               not read beyond that size
+/// @return SmfResult, CantOpen if the file can not be read
+SmfResult SmfFile::load(const std::string &path, const SmfLimits &limits)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return SmfResult::CantOpen;
+    }
+
+    std::vector<uint8_t> contents;
+    uint8_t buffer[64 * 1024];
+    size_t count;
+    while (((count = fread(buffer, 1, sizeof(buffer), file)) > 0) && (contents.size() <= limits.max_file_size))
+    {
+        contents.insert(contents.end(), buffer, buffer + count);
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    if (failed)
+    {
+        return SmfResult::CantOpen;
+    }
+    return read(contents.data(), contents.size(), limits);
+}
+
+/// @brief Encodes the file
+/// @param out std::vector receiving the contents of the file
+/// @return SmfResult, TooLarge if there are more than 65535 tracks or a
+///         track does not fit the format
+SmfResult SmfFile::write(std::vector<uint8_t> &out) const
+{
+    if (tracks.size() > 0xFFFF)
+    {
+        return SmfResult::TooLarge;
+    }
+
+    uint64_t length = 14;
+    for (const SmfTrack &track : tracks)
+    {
+        length += 8 + track.get_length_in_bytes();
+    }
+    out.clear();
+    out.reserve(length);
+
+    out.insert(out.end(), { 'M', 'T', 'h', 'd' });
+    append_u32(out, 6);
+    append_u16(out, format);
+    append_u16(out, tracks.size());
+    append_u16(out, division);
+    for (const SmfTrack &track : tracks)
+    {
+        SmfResult result = track.write(out);
+        if (result != SmfResult::Ok)
+        {
+            return result;
+        }
+    }
+    return SmfResult::Ok;
+}
+
+/// @brief Writes the file atomically, replacing an existing one
+/// @param path std::string, path of the file
+/// @return SmfResult, CantOpen or CantWrite on file errors
+SmfResult SmfFile::save(const std::string &path) const
+{
+    std::vector<uint8_t> contents;
+    SmfResult result = write(contents);
+    if (result != SmfResult::Ok)
+    {
+        return result;
+    }
+
+    return write_file_atomic(path, contents.data(), contents.size());
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef MT_SMF_FILE_H
+#define MT_SMF_FILE_H
+
+#include "mt_smf.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mtcore {
+
+enum class SmfResult {
+    Ok,
+    CantOpen,           // File could not be opened
+    CantWrite,          // File could not be written completely
+    Unrecognized,       // Data does not start with a header chunk
+    InvalidHeader,      // Header chunk is too short or longer than the data
+    Truncated,          // A chunk is longer than the data
+    InvalidTrack,       // A track holds a message that can not be decoded
+    TooLarge,           // A value does not fit the file format
+    LimitExceeded,      // The data exceeds an SmfLimits cap
+};
+
+const char *get_result_text(SmfResult result);
+
+// Replaces a file so it holds either its old or its new contents, also
+// after a crash: the data is written to a temporary file next to it, synced
+// to disk and renamed over the file
+SmfResult write_file_atomic(const std::string &path, const uint8_t *data, uint64_t size);
+
+// Caps on the data accepted by the readers, for files from untrusted
+// sources.  Parsing is linear in the size of the data, the caps bound the
+// memory used and stop files that claim huge messages early.  The defaults
+// accept anything, strict() suits user uploads.
+struct SmfLimits {
+    uint64_t max_file_size = UINT64_MAX;
+    uint32_t max_tracks = UINT32_MAX;
+    uint64_t max_events = UINT64_MAX;               // All tracks together
+    uint32_t max_message_length = UINT32_MAX;       // Payload of meta and sysex messages
+
+    static SmfLimits strict();
+};
+
+// Messages of one track of an SmfFile.  Message bytes are kept in blocks
+// owned by the track, so events stay valid while the track exists.  Tracks
+// can be moved but not copied.
+class SmfTrack {
+    private:
+    static const uint64_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    uint64_t block_used = BLOCK_SIZE;
+
+    uint8_t *allocate(uint64_t size);
+
+    public:
+    std::vector<SmfEvent> events;
+
+    SmfTrack() {}
+    SmfTrack(SmfTrack &&) = default;
+    SmfTrack &operator=(SmfTrack &&) = default;
+    SmfTrack(const SmfTrack &) = delete;
+    SmfTrack &operator=(const SmfTrack &) = delete;
+
+    SmfResult read(const uint8_t *data, uint64_t size, const SmfLimits &limits = SmfLimits(), uint64_t max_events = UINT64_MAX);
+    bool append(uint64_t tick, uint8_t status, const uint8_t *data, uint32_t length);
+    uint64_t get_length_in_bytes() const;
+    SmfResult write(std::vector<uint8_t> &out) const;
+};
+
+// Standard MIDI File in memory, read and written without Godot types
+struct SmfFile {
+    uint16_t format = 1;
+    uint16_t division = 480;        // Ticks per quarter note, or SMPTE format and ticks per frame
+    std::vector<SmfTrack> tracks;
+
+    SmfResult read(const uint8_t *data, uint64_t size, const SmfLimits &limits = SmfLimits());
+    SmfResult load(const std::string &path, const SmfLimits &limits = SmfLimits());
+    SmfResult write(std::vector<uint8_t> &out) const;
+    SmfResult save(const std::string &path) const;
+};
+
+}
+#endif
@@ -0,0 +1,18 @@
+#include "mt_smf_scanner.hpp"
+
+using namespace mtcore;
+
+/// @brief Decodes the next events of the track, see next()
+/// @param events Pointer to an array receiving the events
+/// @param max_count int32_t, size of the 'events' array
+/// @return int32_t, number of events decoded, 0 at the end of the data or
+///         after an error
+int32_t SmfEventScanner::next_batch(Event *events, int32_t max_count)
+{
+    int32_t count = 0;
+    while ((count < max_count) && next(events[count]))
+    {
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,42 @@
+// Standalone driver of the fuzz targets, linked instead of libFuzzer by
+// 'scons fuzz fuzzer=standalone': replays files, or the data on stdin for AFL.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void run_file(FILE *file)
+{
+    std::vector<uint8_t> data;
+    uint8_t buffer[64 * 1024];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+// Runs the target once per file given, or once on stdin for AFL
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        run_file(stdin);
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        FILE *file = fopen(argv[i], "rb");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "%s: could not open %s\n", argv[0], argv[i]);
+            return 1;
+        }
+        run_file(file);
+        fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Fuzz target of the core SMF reader and writer.
+//
+// libFuzzer: scons fuzz                      (needs clang)
+//            bin/mt_smf_fuzzer <corpus dir>
+// AFL and corpus replay: scons fuzz fuzzer=standalone
+//            bin/mt_smf_fuzzer_standalone <files...>, or the data on stdin,
+//            see mt_fuzz_main.cpp
+//
+// Every input is read with strict limits.  Files that read without error
+// must survive a write and re-read unchanged, so the target checks the
+// writer against the reader as well as looking for crashes.
+
+#include "mt_smf_file.hpp"
+#include "mt_smf_scanner.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace mtcore;
+
+namespace {
+
+void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "mt_smf_fuzzer: %s\n", what);
+        abort();
+    }
+}
+
+bool same_events(const SmfFile &a, const SmfFile &b)
+{
+    if ((a.format != b.format) || (a.division != b.division) || (a.tracks.size() != b.tracks.size()))
+    {
+        return false;
+    }
+    for (size_t t = 0; t < a.tracks.size(); ++t)
+    {
+        const std::vector<SmfEvent> &x = a.tracks[t].events;
+        const std::vector<SmfEvent> &y = b.tracks[t].events;
+        if (x.size() != y.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            if ((x[i].tick != y[i].tick) || (x[i].length != y[i].length) ||
+                (memcmp(x[i].bytes, y[i].bytes, x[i].length) != 0) ||
+                (x[i].data_start != y[i].data_start) || (x[i].data_length != y[i].data_length))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // The scanner on its own, as used by MTMidiFile.scan_bytes()
+    SmfEventScanner scanner(data, size);
+    SmfEventScanner::Event event;
+    uint64_t last_tick = 0;
+    while (scanner.next(event))
+    {
+        check((uint64_t)event.offset + event.length <= size, "scanned event crosses the end of the data");
+        check(event.data_offset + (uint64_t)event.data_length <= size, "scanned payload crosses the end of the data");
+        check(event.tick >= last_tick, "scanned ticks go backwards");
+        last_tick = event.tick;
+    }
+
+    SmfLimits limits = SmfLimits::strict();
+    SmfFile file;
+    if (file.read(data, size, limits) != SmfResult::Ok)
+    {
+        return 0;
+    }
+
+    uint64_t event_count = 0;
+    for (const SmfTrack &track : file.tracks)
+    {
+        event_count += track.events.size();
+    }
+    check(event_count <= limits.max_events, "event limit not enforced");
+    check(file.tracks.size() <= limits.max_tracks, "track limit not enforced");
+
+    std::vector<uint8_t> written;
+    if (file.write(written) != SmfResult::Ok)
+    {
+        return 0;
+    }
+    SmfFile reread;
+    check(reread.read(written.data(), written.size()) == SmfResult::Ok, "written file does not read back");
+    check(same_events(file, reread), "written file reads back different events");
+
+    std::vector<uint8_t> rewritten;
+    check(reread.write(rewritten) == SmfResult::Ok, "re-read file does not write");
+    check(written == rewritten, "writing is not stable");
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Fuzz target of resumable track parsing, as MTMidiStreamParser does it.
+//
+// libFuzzer: scons fuzz                      (needs clang)
+//            bin/mt_smf_split_fuzzer <corpus dir>
+// AFL and corpus replay: scons fuzz fuzzer=standalone
+//            bin/mt_smf_split_fuzzer_standalone <files...>, or the data on stdin
+//
+// The first two bytes of the input seed the split points, the rest is the
+// data of one track chunk.  The data is fed in pieces of random length to
+// the loop of MTMidiStreamParser::parse_track_data(), which decodes with
+// peek_msg_length(), store_msg() and init_event() like
+// MTMidiMsg::decode_event() and store_event().  The parser itself needs
+// the engine, so the loop is repeated here on the same core functions.
+// Any split must give the same events as SmfEventScanner on the whole
+// data, and fail exactly where the scanner fails.
+
+#include "mt_smf.hpp"
+#include "mt_smf_scanner.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace mtcore;
+
+namespace {
+
+void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "mt_smf_split_fuzzer: %s\n", what);
+        abort();
+    }
+}
+
+// State of MTMidiStreamParser while it reads one track
+struct SplitParser {
+    std::vector<uint8_t> pending;
+    uint64_t pending_index = 0;
+    uint64_t chunk_remaining;
+    uint64_t tick = 0;
+    uint8_t running_status = 0;
+    uint8_t channel_prefix = 0;
+    uint8_t port_prefix = 0;
+    bool failed = false;
+    std::vector<std::unique_ptr<uint8_t[]>> stored;     // Message bytes, as the arena holds them
+    std::vector<SmfEvent> events;
+
+    explicit SplitParser(uint64_t chunk_length) : chunk_remaining(chunk_length) {}
+
+    void feed(const uint8_t *data, uint64_t size)
+    {
+        pending.insert(pending.end(), data, data + size);
+        parse_track_data();
+        // Consumed bytes are dropped, so messages continue at the buffer start
+        pending.erase(pending.begin(), pending.begin() + pending_index);
+        pending_index = 0;
+    }
+
+    void parse_track_data()
+    {
+        while (!failed && (chunk_remaining > 0))
+        {
+            uint64_t available = std::min((uint64_t)(pending.size() - pending_index), chunk_remaining);
+            const uint8_t *data = pending.data() + pending_index;
+
+            uint32_t tick_delta;
+            int32_t delta_size = peek_variable_length(data, available, tick_delta);
+            int32_t msg_size = delta_size > 0 ?
+                peek_msg_length(data + delta_size, available - delta_size, running_status) : delta_size;
+            if (msg_size == 0)
+            {
+                // Waits for the rest of the message, unless the chunk ends first
+                failed = available == chunk_remaining;
+                return;
+            }
+            if (msg_size < 0)
+            {
+                failed = true;
+                return;
+            }
+
+            const uint8_t *msg = data + delta_size;
+            stored.emplace_back(new uint8_t[get_stored_length(msg, msg_size)]);
+            uint32_t stored_length = store_msg(msg, msg_size, running_status, stored.back().get());
+            SmfEvent event;
+            init_event(stored.back().get(), stored_length, channel_prefix, port_prefix, event);
+            tick += tick_delta;
+            event.tick = tick;
+            events.push_back(event);
+            pending_index += delta_size + msg_size;
+            chunk_remaining -= delta_size + msg_size;
+        }
+    }
+};
+
+// Stored message and scanned event describe the same message
+bool same_message(const SmfEvent &stored, const SmfEventScanner::Event &scanned, const uint8_t *data)
+{
+    if ((stored.tick != scanned.tick) || (stored.bytes[0] != scanned.status))
+    {
+        return false;
+    }
+    if (stored.is_channel_msg())
+    {
+        // init_event() masks note numbers and velocities to 7 bits
+        uint8_t mask = (scanned.status & 0xE0) == STATUS_NOTE_OFF ? 0x7F : 0xFF;
+        if (stored.length != scanned.data_length + 1)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < scanned.data_length; ++i)
+        {
+            if (stored.bytes[1 + i] != (data[scanned.data_offset + i] & mask))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return (stored.data_length == scanned.data_length) &&
+           (stored.data_start + stored.data_length == stored.length) &&
+           ((stored.bytes[0] != STATUS_META) || (stored.bytes[1] == scanned.meta_type)) &&
+           (memcmp(stored.bytes + stored.data_start, data + scanned.data_offset, scanned.data_length) == 0);
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 2)
+    {
+        return 0;
+    }
+    uint32_t random = (((data[0] << 8) | data[1]) * 2654435761u) | 1;
+    data += 2;
+    size -= 2;
+
+    SplitParser parser(size);
+    for (uint64_t offset = 0; (offset < size) && !parser.failed;)
+    {
+        // xorshift32, mostly short pieces to split messages everywhere
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        uint64_t piece = (random & 0xC0) == 0 ? 1 + (random >> 8) % 4096 : 1 + (random >> 8) % 8;
+        piece = std::min(piece, (uint64_t)size - offset);
+        parser.feed(data + offset, piece);
+        offset += piece;
+    }
+    check(parser.failed || (parser.chunk_remaining == 0), "split parse stopped before the end of the chunk");
+
+    SmfEventScanner scanner(data, size);
+    SmfEventScanner::Event event;
+    size_t index = 0;
+    while (scanner.next(event))
+    {
+        check(index < parser.events.size(), "split parse has fewer events than the scanner");
+        check(same_message(parser.events[index], event, data), "split parse and scanner disagree on an event");
+        ++index;
+    }
+    check(index == parser.events.size(), "split parse has more events than the scanner");
+    check(scanner.has_error() == parser.failed, "split parse and scanner disagree on an error");
+    return 0;
+}
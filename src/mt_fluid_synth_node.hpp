@@ -207,6 +207,14 @@ public:
     void synth_map_channel(int channel, int mapped_channel);
     int synth_setup_channel(int channel, int sfont_id, int bank_num, int program, int reverb, int chorus,
         int volume = 100, int pan = 64, int expression = 127);
+    /**
+     * @brief Maps an interpolation setting to the FluidSynth method.
+     * 
+     * @param method 0 = None, 1 = Linear, 2 = 4th Order, 3 = 7th Order,
+     *               anything else is the FluidSynth default.
+     * @return fluid_interp Interpolation method.
+     */
+    static fluid_interp get_interp_method(int method);
     int synth_set_interpolation(int method);
     int synth_play_messages(int msg_count, PackedInt32Array indices, PackedByteArray data);
     int synth_system_reset();
@@ -192,24 +192,22 @@ int MTFluidSynthNode::synth_setup_channel(int channel, int sfont_id, int bank_nu
     return 0;
 }
 
-int MTFluidSynthNode::synth_set_interpolation(int method) {
-    fluid_interp interp_method = FLUID_INTERP_DEFAULT;
+fluid_interp MTFluidSynthNode::get_interp_method(int method) {
     switch(method) {
         case 0:
-            interp_method = FLUID_INTERP_NONE;
-            break;
+            return FLUID_INTERP_NONE;
         case 1:
-            interp_method = FLUID_INTERP_LINEAR;
-            break;
+            return FLUID_INTERP_LINEAR;
         case 2:
-            interp_method = FLUID_INTERP_4THORDER;
-            break;
+            return FLUID_INTERP_4THORDER;
         case 3:
-            interp_method = FLUID_INTERP_7THORDER;
-            break;
+            return FLUID_INTERP_7THORDER;
     }
+    return FLUID_INTERP_DEFAULT;
+}
 
-    if (fluid_synth_set_interp_method(synth, -1, interp_method) == FLUID_FAILED) {
+int MTFluidSynthNode::synth_set_interpolation(int method) {
+    if (fluid_synth_set_interp_method(synth, -1, get_interp_method(method)) == FLUID_FAILED) {
         WARN_PRINT_ED("Failed to set interpolation method");
         return -1;
     }
@@ -264,23 +262,7 @@ int MTFluidSynthNode::synth_render_file(String midi_file, String output_file, St
         
         fluid_synth_sfload(tmp_synth, sf_path.ascii(), true);
 
-        fluid_interp interp_method = FLUID_INTERP_DEFAULT;
-        switch(interpolation) {
-            case 0:
-                interp_method = FLUID_INTERP_NONE;
-                break;
-            case 1:
-                interp_method = FLUID_INTERP_LINEAR;
-                break;
-            case 2:
-                interp_method = FLUID_INTERP_4THORDER;
-                break;
-            case 3:
-                interp_method = FLUID_INTERP_7THORDER;
-                break;
-        }
-
-        if (fluid_synth_set_interp_method(tmp_synth, -1, interp_method) == FLUID_FAILED) {
+        if (fluid_synth_set_interp_method(tmp_synth, -1, get_interp_method(interpolation)) == FLUID_FAILED) {
             WARN_PRINT_ED("Failed to set interpolation method");
             delete_fluid_synth(tmp_synth);
             delete_fluid_settings(tmp_settings);
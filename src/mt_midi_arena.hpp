@@ -0,0 +1,90 @@
+#ifndef MT_MIDI_ARENA_H
+#define MT_MIDI_ARENA_H
+
+#include <godot_cpp/core/memory.hpp>
+#include <cstring>
+
+namespace godot {
+
+// Bump allocator for the message bytes of an MTMidiFile.  Memory is taken
+// from large blocks and only released all at once, by clear() or when the
+// arena is destroyed, so unloading a file costs one free per block instead
+// of one per message.  Not thread-safe, each file is parsed by one thread.
+class MTMidiArena {
+    private:
+    struct Block {
+        Block *next;
+        uint64_t size;
+        uint64_t used;
+
+        uint8_t *data() { return reinterpret_cast<uint8_t *>(this + 1); }
+    };
+
+    static const uint64_t BLOCK_SIZE = 64 * 1024;
+
+    Block *head = nullptr;
+    uint64_t allocated_bytes = 0;
+    uint64_t reserved_bytes = 0;
+
+    public:
+    MTMidiArena() {}
+    ~MTMidiArena() { clear(); }
+    MTMidiArena(const MTMidiArena &) = delete;
+    MTMidiArena &operator=(const MTMidiArena &) = delete;
+
+    uint8_t *allocate(uint64_t size)
+    {
+        if ((head == nullptr) || (head->size - head->used < size))
+        {
+            // Large requests get a block of their own, behind the current one
+            // so its free space can still be used
+            bool dedicated = size > BLOCK_SIZE / 4;
+            uint64_t block_size = dedicated ? size : BLOCK_SIZE;
+            Block *block = (Block *)memalloc(sizeof(Block) + block_size);
+            block->size = block_size;
+            block->used = 0;
+            reserved_bytes += block_size;
+
+            if (dedicated && (head != nullptr))
+            {
+                block->next = head->next;
+                head->next = block;
+                block->used = size;
+                allocated_bytes += size;
+                return block->data();
+            }
+            block->next = head;
+            head = block;
+        }
+
+        uint8_t *ptr = head->data() + head->used;
+        head->used += size;
+        allocated_bytes += size;
+        return ptr;
+    }
+
+    uint8_t *store(const uint8_t *data, uint64_t size)
+    {
+        uint8_t *ptr = allocate(size);
+        memcpy(ptr, data, size);
+        return ptr;
+    }
+
+    void clear()
+    {
+        while (head != nullptr)
+        {
+            Block *next = head->next;
+            memfree(head);
+            head = next;
+        }
+        allocated_bytes = 0;
+        reserved_bytes = 0;
+    }
+
+    uint64_t get_allocated_bytes() const { return allocated_bytes; }
+    uint64_t get_reserved_bytes() const { return reserved_bytes; }
+};
+
+}
+#endif
@@ -0,0 +1,327 @@
+#include "mt_midi_cache.hpp"
+#include "mt_midi_file.hpp"
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/core/memory.hpp>
+
+using namespace godot;
+
+static const uint8_t CACHE_MAGIC[4] = { 'M', 'T', 'M', 'C' };
+
+static inline uint16_t decode_u16(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static inline uint32_t decode_u32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint64_t decode_u64(const uint8_t *data)
+{
+    return decode_u32(data) | ((uint64_t)decode_u32(data + 4) << 32);
+}
+
+static inline void encode_u16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+static inline void encode_u32(uint8_t *data, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        data[i] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+static inline void encode_u64(uint8_t *data, uint64_t value)
+{
+    encode_u32(data, value & 0xFFFFFFFF);
+    encode_u32(data + 4, value >> 32);
+}
+
+static inline uint64_t align_8(uint64_t value)
+{
+    return (value + 7) & ~(uint64_t)7;
+}
+
+static inline bool range_in_file(uint64_t offset, uint64_t length, uint64_t file_size)
+{
+    return (offset <= file_size) && (length <= file_size - offset);
+}
+
+/// @brief Restores a decoded MIDI file from a cache file
+/// The target file is expected to contain no tracks.
+/// @param file Pointer to the MTMidiFile to fill
+/// @param file_path String, path of the cache file
+/// @return Error, OK on success
+Error MTMidiCache::read(MTMidiFile *file, const String &file_path)
+{
+    if (!FileAccess::file_exists(file_path))
+    {
+        return Error::ERR_FILE_NOT_FOUND;
+    }
+
+    PackedByteArray buffer = FileAccess::get_file_as_bytes(file_path);
+    uint64_t file_size = buffer.size();
+    const uint8_t *data = buffer.ptr();
+
+    if ((file_size < HEADER_SIZE) || (memcmp(data, CACHE_MAGIC, 4) != 0))
+    {
+        return Error::ERR_FILE_UNRECOGNIZED;
+    }
+
+    if (decode_u32(data + 4) != VERSION)
+    {
+        WARN_PRINT_ED(vformat("Unsupported MIDI cache version %d, the cache must be rebuilt", decode_u32(data + 4)));
+        return Error::ERR_FILE_UNRECOGNIZED;
+    }
+
+    uint32_t track_count = decode_u32(data + 16);
+    uint32_t tempo_count = decode_u32(data + 20);
+    uint64_t tempo_offset = decode_u64(data + 24);
+    uint64_t track_table_offset = decode_u64(data + 32);
+
+    if ((decode_u64(data + 40) != file_size) ||
+        !range_in_file(tempo_offset, (uint64_t)tempo_count * TEMPO_SIZE, file_size) ||
+        !range_in_file(track_table_offset, (uint64_t)track_count * TRACK_SIZE, file_size))
+    {
+        return Error::ERR_FILE_CORRUPT;
+    }
+
+    MIDIChunkHeader header(MIDIChunkHeader::HeaderType::File, 6);
+    header.set_format(decode_u16(data + 8));
+    header.set_track_count(decode_u16(data + 10));
+    header.set_division(decode_u16(data + 12));
+    if (!file->apply_file_header(header))
+    {
+        return file->get_last_error();
+    }
+
+    file->tempo_map.resize(tempo_count);
+    for (uint32_t i = 0; i < tempo_count; ++i)
+    {
+        const uint8_t *tempo = data + tempo_offset + i * TEMPO_SIZE;
+        file->tempo_map.write[i] = { decode_u64(tempo), decode_u32(tempo + 8) };
+    }
+
+    for (uint32_t i = 0; i < track_count; ++i)
+    {
+        const uint8_t *entry = data + track_table_offset + i * TRACK_SIZE;
+        uint32_t track_id = decode_u32(entry);
+        uint32_t msg_count = decode_u32(entry + 4);
+        uint64_t events_offset = decode_u64(entry + 8);
+        uint64_t payload_offset = decode_u64(entry + 16);
+        uint64_t payload_size = decode_u64(entry + 24);
+
+        if (!range_in_file(events_offset, (uint64_t)msg_count * EVENT_SIZE, file_size) ||
+            !range_in_file(payload_offset, payload_size, file_size) ||
+            file->tracks.has(track_id))
+        {
+            return Error::ERR_FILE_CORRUPT;
+        }
+
+        MTMidiTrack *track = memnew(MTMidiTrack(track_id, &file->arena));
+        file->tracks.insert(track_id, track);
+
+        // The payload is copied into the arena in one piece, and the events
+        // point into it.  Every message must decode to exactly its length,
+        // and its payload position and prefixes are decoded again rather than
+        // trusted, as the file may be corrupt.  Track metadata is rebuilt as
+        // the events are appended.
+        uint8_t *payload = file->arena.store(data + payload_offset, payload_size);
+        uint8_t channel_prefix = 0;
+        uint8_t port_prefix = 0;
+        for (uint32_t m = 0; m < msg_count; ++m)
+        {
+            const uint8_t *event = data + events_offset + (uint64_t)m * EVENT_SIZE;
+            uint32_t msg_offset = decode_u32(event + 8);
+            uint32_t msg_length = decode_u32(event + 12);
+            if ((msg_length == 0) || !range_in_file(msg_offset, msg_length, payload_size) ||
+                !mtcore::is_status_byte(payload[msg_offset]) ||
+                (mtcore::peek_msg_length(payload + msg_offset, msg_length, 0) != (int32_t)msg_length))
+            {
+                return Error::ERR_FILE_CORRUPT;
+            }
+
+            MTMidiEvent msg;
+            MTMidiMsg::init_event(payload + msg_offset, msg_length, channel_prefix, port_prefix, msg);
+            msg.tick = decode_u64(event);
+            track->append_event(msg);
+        }
+    }
+
+    return Error::OK;
+}
+
+/// @brief Writes a decoded MIDI file as a cache file
+/// Updates the tempo map of the file before writing.
+/// @param file Pointer to the MTMidiFile to write
+/// @param file_path String, path of the cache file
+/// @return Error, OK on success
+Error MTMidiCache::write(MTMidiFile *file, const String &file_path)
+{
+    file->update_tempo_map();
+
+    uint32_t track_count = file->tracks.size();
+    uint32_t tempo_count = file->tempo_map.size();
+    uint64_t tempo_offset = HEADER_SIZE;
+    uint64_t track_table_offset = tempo_offset + (uint64_t)tempo_count * TEMPO_SIZE;
+    uint64_t file_size = track_table_offset + (uint64_t)track_count * TRACK_SIZE;
+
+    // Track data offsets
+    Vector<uint64_t> payload_sizes;
+    for (KeyValue<uint32_t, MTMidiTrack*> element : file->tracks)
+    {
+        MTMidiTrack *track = element.value;
+        uint64_t payload_size = 0;
+        for (const MTMidiEvent &msg : track->get_events())
+        {
+            payload_size += msg.length;
+        }
+        payload_sizes.push_back(payload_size);
+        file_size += (uint64_t)track->get_event_count() * EVENT_SIZE + align_8(payload_size);
+    }
+
+    PackedByteArray buffer;
+    buffer.resize(file_size);
+    uint8_t *data = buffer.ptrw();
+    memset(data, 0, file_size);
+
+    uint16_t division = file->ticks_per_quarter;
+    if (file->smpte_format != 0)
+    {
+        division = ((uint8_t)file->smpte_format << 8) | file->ticks_per_frame;
+    }
+
+    memcpy(data, CACHE_MAGIC, 4);
+    encode_u32(data + 4, VERSION);
+    encode_u16(data + 8, file->file_format);
+    encode_u16(data + 10, file->track_count);
+    encode_u16(data + 12, division);
+    encode_u32(data + 16, track_count);
+    encode_u32(data + 20, tempo_count);
+    encode_u64(data + 24, tempo_offset);
+    encode_u64(data + 32, track_table_offset);
+    encode_u64(data + 40, file_size);
+
+    for (uint32_t i = 0; i < tempo_count; ++i)
+    {
+        uint8_t *tempo = data + tempo_offset + i * TEMPO_SIZE;
+        encode_u64(tempo, file->tempo_map[i].tick);
+        encode_u32(tempo + 8, file->tempo_map[i].usecs_per_quarter);
+    }
+
+    uint32_t track_index = 0;
+    uint64_t offset = track_table_offset + (uint64_t)track_count * TRACK_SIZE;
+    for (KeyValue<uint32_t, MTMidiTrack*> element : file->tracks)
+    {
+        MTMidiTrack *track = element.value;
+        uint32_t msg_count = track->get_event_count();
+        uint64_t events_offset = offset;
+        uint64_t payload_offset = events_offset + (uint64_t)msg_count * EVENT_SIZE;
+        uint64_t payload_size = payload_sizes[track_index];
+
+        uint8_t *entry = data + track_table_offset + track_index * TRACK_SIZE;
+        encode_u32(entry, track->track_id);
+        encode_u32(entry + 4, msg_count);
+        encode_u64(entry + 8, events_offset);
+        encode_u64(entry + 16, payload_offset);
+        encode_u64(entry + 24, payload_size);
+
+        uint8_t *event = data + events_offset;
+        uint32_t msg_offset = 0;
+        for (const MTMidiEvent &msg : track->get_events())
+        {
+            uint32_t msg_length = msg.length;
+            encode_u64(event, msg.tick);
+            encode_u32(event + 8, msg_offset);
+            encode_u32(event + 12, msg_length);
+            memcpy(data + payload_offset + msg_offset, msg.bytes, msg_length);
+            msg_offset += msg_length;
+            event += EVENT_SIZE;
+        }
+
+        offset = payload_offset + align_8(payload_size);
+        ++track_index;
+    }
+
+    Ref<FileAccess> cache_file = FileAccess::open(file_path, FileAccess::ModeFlags::WRITE);
+    if (cache_file.is_null())
+    {
+        return FileAccess::get_open_error();
+    }
+
+    Error result = Error::OK;
+    if (!cache_file->store_buffer(buffer))
+    {
+        result = cache_file->get_error();
+        if (result == Error::OK)
+        {
+            result = Error::ERR_FILE_CANT_WRITE;
+        }
+    }
+    cache_file->close();
+    return result;
+}
+
+PackedStringArray MTMidiCacheFormatLoader::_get_recognized_extensions() const
+{
+    PackedStringArray extensions;
+    extensions.append(MTMidiCache::get_extension());
+    return extensions;
+}
+
+bool MTMidiCacheFormatLoader::_handles_type(const StringName &type) const
+{
+    return (type == StringName("MTMidiFile")) || (type == StringName("Resource"));
+}
+
+String MTMidiCacheFormatLoader::_get_resource_type(const String &path) const
+{
+    if (path.get_extension().to_lower() == MTMidiCache::get_extension())
+    {
+        return "MTMidiFile";
+    }
+    return "";
+}
+
+Variant MTMidiCacheFormatLoader::_load(const String &path, const String &original_path,
+                                       bool use_sub_threads, int32_t cache_mode) const
+{
+    Ref<MTMidiFile> file;
+    file.instantiate();
+    if (!file->read_cache(path))
+    {
+        return (int64_t)file->get_last_error();
+    }
+    return file;
+}
+
+Error MTMidiCacheFormatSaver::_save(const Ref<Resource> &resource, const String &path, uint32_t flags)
+{
+    Ref<MTMidiFile> file = resource;
+    if (file.is_null())
+    {
+        return Error::ERR_INVALID_PARAMETER;
+    }
+    return file->write_cache(path, true) ? Error::OK : file->get_last_error();
+}
+
+bool MTMidiCacheFormatSaver::_recognize(const Ref<Resource> &resource) const
+{
+    return Ref<MTMidiFile>(resource).is_valid();
+}
+
+PackedStringArray MTMidiCacheFormatSaver::_get_recognized_extensions(const Ref<Resource> &resource) const
+{
+    PackedStringArray extensions;
+    if (_recognize(resource))
+    {
+        extensions.append(MTMidiCache::get_extension());
+    }
+    return extensions;
+}
@@ -0,0 +1,62 @@
+#ifndef MT_MIDI_CACHE_H
+#define MT_MIDI_CACHE_H
+
+#include <godot_cpp/classes/resource.hpp>
+#include <godot_cpp/classes/resource_format_loader.hpp>
+#include <godot_cpp/classes/resource_format_saver.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+namespace godot {
+
+class MTMidiFile;
+
+// Binary cache of a decoded MTMidiFile, so files can be loaded without
+// decoding any MIDI data.  All values are little-endian and every table
+// starts on an 8 byte boundary, so the file can also be used when mapped.
+//
+//   Header       48 bytes
+//   Tempo map    tempo_count * 16 bytes
+//   Track table  track_count * 32 bytes
+//   Track data   per track: msg_count * 16 byte events, followed by the
+//                message bytes the events refer to
+class MTMidiCache {
+    public:
+    static const uint32_t VERSION = 2;
+    static const uint32_t HEADER_SIZE = 48;
+    static const uint32_t TEMPO_SIZE = 16;
+    static const uint32_t TRACK_SIZE = 32;
+    static const uint32_t EVENT_SIZE = 16;
+
+    static String get_extension() { return "mtmidi"; }
+    static Error read(MTMidiFile *file, const String &file_path);
+    static Error write(MTMidiFile *file, const String &file_path);
+};
+
+class MTMidiCacheFormatLoader : public ResourceFormatLoader {
+    GDCLASS(MTMidiCacheFormatLoader, ResourceFormatLoader)
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    PackedStringArray _get_recognized_extensions() const override;
+    bool _handles_type(const StringName &type) const override;
+    String _get_resource_type(const String &path) const override;
+    Variant _load(const String &path, const String &original_path, bool use_sub_threads, int32_t cache_mode) const override;
+};
+
+class MTMidiCacheFormatSaver : public ResourceFormatSaver {
+    GDCLASS(MTMidiCacheFormatSaver, ResourceFormatSaver)
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    Error _save(const Ref<Resource> &resource, const String &path, uint32_t flags) override;
+    bool _recognize(const Ref<Resource> &resource) const override;
+    PackedStringArray _get_recognized_extensions(const Ref<Resource> &resource) const override;
+};
+
+}
+#endif
@@ -0,0 +1,90 @@
+#include "mt_midi_event_list.hpp"
+
+using namespace godot;
+
+/// @brief Recalculates the chunk ends from a chunk onwards
+/// @param first_chunk int64_t, first chunk whose size changed
+void MTMidiEventList::update_chunk_ends(int64_t first_chunk)
+{
+    chunk_ends.resize(chunks.size());
+    int64_t *ends = chunk_ends.ptrw();
+    int64_t end = first_chunk > 0 ? ends[first_chunk - 1] : 0;
+    for (int64_t chunk = first_chunk; chunk < chunks.size(); ++chunk)
+    {
+        end += chunks[chunk].size();
+        ends[chunk] = end;
+    }
+}
+
+/// @brief Appends an event
+/// Only the last chunk is changed, or a new one started.
+/// @param event MTMidiEvent to append
+void MTMidiEventList::push_back(const MTMidiEvent &event)
+{
+    int64_t last = chunks.size() - 1;
+    if ((last < 0) || (chunks[last].size() >= CHUNK_SIZE))
+    {
+        Vector<MTMidiEvent> chunk;
+        chunk.push_back(event);
+        chunks.push_back(chunk);
+        chunk_ends.push_back(++count);
+        return;
+    }
+
+    chunks.write[last].push_back(event);
+    chunk_ends.write[last] = ++count;
+}
+
+/// @brief Inserts an event before another one
+/// Copies only the chunk receiving the event, which is split in two once it
+/// grows beyond MAX_CHUNK_SIZE.
+/// @param index int64_t, index of the event to insert before, size() to append
+/// @param event MTMidiEvent to insert
+void MTMidiEventList::insert(int64_t index, const MTMidiEvent &event)
+{
+    if (index >= count)
+    {
+        push_back(event);
+        return;
+    }
+
+    int64_t chunk = find_chunk(index);
+    int64_t first = chunk > 0 ? chunk_ends[chunk - 1] : 0;
+    Vector<MTMidiEvent> &events = chunks.write[chunk];
+    events.insert(index - first, event);
+    ++count;
+
+    if (events.size() > MAX_CHUNK_SIZE)
+    {
+        int64_t half = events.size() / 2;
+        Vector<MTMidiEvent> second = events.slice(half, events.size());
+        events.resize(half);
+        chunks.insert(chunk + 1, second);
+    }
+    update_chunk_ends(chunk);
+}
+
+/// @brief Removes an event, copying only the chunk holding it
+/// @param index int64_t, index of the event, must be valid
+void MTMidiEventList::remove_at(int64_t index)
+{
+    int64_t chunk = find_chunk(index);
+    int64_t first = chunk > 0 ? chunk_ends[chunk - 1] : 0;
+    if (chunks[chunk].size() == 1)
+    {
+        chunks.remove_at(chunk);
+    }
+    else
+    {
+        chunks.write[chunk].remove_at(index - first);
+    }
+    --count;
+    update_chunk_ends(chunk);
+}
+
+void MTMidiEventList::clear()
+{
+    chunks.clear();
+    chunk_ends.clear();
+    count = 0;
+}
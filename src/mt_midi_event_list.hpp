@@ -0,0 +1,101 @@
+#ifndef MT_MIDI_EVENT_LIST_H
+#define MT_MIDI_EVENT_LIST_H
+
+#include <godot_cpp/templates/vector.hpp>
+#include "mt_midi_msg.hpp"
+
+namespace godot {
+
+// Messages of a track, stored in chunks of up to MAX_CHUNK_SIZE events.
+// Both the chunk table and the chunks are copy-on-write Vectors, so copying
+// a list is O(1) and shares all events.  A later edit copies the chunk table
+// once and only the chunk it changes, which makes copies cheap snapshots
+// for undo.
+class MTMidiEventList {
+    public:
+    static const int32_t CHUNK_SIZE = 256;          // Chunk size when appending
+    static const int32_t MAX_CHUNK_SIZE = 512;      // Chunks are split beyond this size
+
+    class ConstIterator {
+        const MTMidiEventList *list;
+        int64_t chunk;
+        int64_t offset;
+
+        public:
+        ConstIterator() : list(nullptr), chunk(0), offset(0) {}
+        ConstIterator(const MTMidiEventList *list, int64_t chunk) : list(list), chunk(chunk), offset(0) {}
+        const MTMidiEvent &operator*() const { return list->chunks[chunk][offset]; }
+        bool operator!=(const ConstIterator &other) const { return (chunk != other.chunk) || (offset != other.offset); }
+        ConstIterator &operator++()
+        {
+            if (++offset == list->chunks[chunk].size())
+            {
+                ++chunk;
+                offset = 0;
+            }
+            return *this;
+        }
+    };
+
+    private:
+    Vector<Vector<MTMidiEvent>> chunks;
+    Vector<int64_t> chunk_ends;     // Index after the last event of each chunk
+    int64_t count = 0;
+
+    int64_t find_chunk(int64_t index) const;
+    void update_chunk_ends(int64_t first_chunk);
+
+    public:
+    int64_t size() const { return count; }
+    bool is_empty() const { return count == 0; }
+    const MTMidiEvent &operator[](int64_t index) const;
+    const MTMidiEvent &get_last() const { return chunks[chunks.size() - 1][chunks[chunks.size() - 1].size() - 1]; }
+    int64_t get_chunk_count() const { return chunks.size(); }
+    const Vector<MTMidiEvent> &get_chunk(int64_t chunk) const { return chunks[chunk]; }
+    bool shares_storage(const MTMidiEventList &other) const { return (count == other.count) && (chunks.ptr() == other.chunks.ptr()); }
+
+    void push_back(const MTMidiEvent &event);
+    void insert(int64_t index, const MTMidiEvent &event);
+    void remove_at(int64_t index);
+    void clear();
+
+    ConstIterator begin() const { return ConstIterator(this, 0); }
+    ConstIterator end() const { return ConstIterator(this, chunks.size()); }
+};
+
+/// @brief Returns an event by index
+/// Finds the chunk by binary search, prefer iterating for sequential access.
+/// @param index int64_t, index of the event, must be valid
+/// @return const MTMidiEvent&, valid until the list is changed
+inline const MTMidiEvent &MTMidiEventList::operator[](int64_t index) const
+{
+    int64_t chunk = find_chunk(index);
+    int64_t first = chunk > 0 ? chunk_ends[chunk - 1] : 0;
+    return chunks[chunk][index - first];
+}
+
+/// @brief Finds the chunk holding an event
+/// @param index int64_t, index of the event, must be valid
+/// @return int64_t, index of the chunk
+inline int64_t MTMidiEventList::find_chunk(int64_t index) const
+{
+    const int64_t *ends = chunk_ends.ptr();
+    int64_t low = 0;
+    int64_t high = chunk_ends.size() - 1;
+    while (low < high)
+    {
+        int64_t mid = (low + high) / 2;
+        if (ends[mid] <= index)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+}
+#endif
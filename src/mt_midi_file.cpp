@@ -1,4 +1,5 @@
 #include "mt_midi_file.hpp"
+#include "mt_midi_cache.hpp"
 #include <godot_cpp/core/error_macros.hpp>
 #include <godot_cpp/core/memory.hpp>
 
@@ -7,26 +8,56 @@ using namespace godot;
 void MTMidiFile::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("read_file", "file_path"), &MTMidiFile::read_file);
 	ClassDB::bind_method(D_METHOD("write_file", "file_path", "overwrite"), &MTMidiFile::write_file);
+	ClassDB::bind_method(D_METHOD("save_async", "file_path", "overwrite"), &MTMidiFile::save_async);
+	ClassDB::bind_method(D_METHOD("is_saving"), &MTMidiFile::is_saving);
+	ClassDB::bind_method(D_METHOD("wait_for_save"), &MTMidiFile::wait_for_save);
 	ClassDB::bind_method(D_METHOD("update_file_name", "file_path"), &MTMidiFile::update_file_name);
 	ClassDB::bind_method(D_METHOD("build_playable_msg_list"), &MTMidiFile::build_playable_msg_list);
 	ClassDB::bind_method(D_METHOD("get_last_error"), &MTMidiFile::get_last_error);
+	ClassDB::bind_method(D_METHOD("set_strict_parsing", "strict"), &MTMidiFile::set_strict_parsing);
+	ClassDB::bind_method(D_METHOD("is_strict_parsing"), &MTMidiFile::is_strict_parsing);
+	ClassDB::bind_method(D_METHOD("build_seek_index", "checkpoint_interval"), &MTMidiFile::build_seek_index, DEFVAL(256));
+	ClassDB::bind_method(D_METHOD("seek", "tick"), &MTMidiFile::seek);
+	ClassDB::bind_method(D_METHOD("read_cache", "file_path"), &MTMidiFile::read_cache);
+	ClassDB::bind_method(D_METHOD("write_cache", "file_path", "overwrite"), &MTMidiFile::write_cache);
+	ClassDB::bind_method(D_METHOD("update_tempo_map"), &MTMidiFile::update_tempo_map);
+	ClassDB::bind_method(D_METHOD("tick_to_seconds", "tick"), &MTMidiFile::tick_to_seconds);
+	ClassDB::bind_method(D_METHOD("get_note_spans", "track_id"), &MTMidiFile::get_note_spans);
+	ClassDB::bind_method(D_METHOD("build_note_index", "track_id"), &MTMidiFile::build_note_index, DEFVAL(-1));
+	ClassDB::bind_method(D_METHOD("query_notes", "from_tick", "to_tick"), &MTMidiFile::query_notes);
+	ClassDB::bind_method(D_METHOD("get_track_events", "track_id"), &MTMidiFile::get_track_events);
+	ClassDB::bind_method(D_METHOD("get_merged_events"), &MTMidiFile::get_merged_events);
+	ClassDB::bind_method(D_METHOD("set_track_events", "track_id", "ticks", "statuses", "offsets", "data"), &MTMidiFile::set_track_events);
+	ClassDB::bind_method(D_METHOD("insert_event", "track_id", "tick", "status", "data"), &MTMidiFile::insert_event);
+	ClassDB::bind_method(D_METHOD("remove_event", "track_id", "index"), &MTMidiFile::remove_event);
+	ClassDB::bind_method(D_METHOD("create_snapshot"), &MTMidiFile::create_snapshot);
+	ClassDB::bind_method(D_METHOD("restore_snapshot", "snapshot_id"), &MTMidiFile::restore_snapshot);
+	ClassDB::bind_method(D_METHOD("free_snapshot", "snapshot_id"), &MTMidiFile::free_snapshot);
+	ClassDB::bind_method(D_METHOD("clear_snapshots"), &MTMidiFile::clear_snapshots);
+	ClassDB::bind_method(D_METHOD("merge_tracks"), &MTMidiFile::merge_tracks);
+	ClassDB::bind_method(D_METHOD("split_tracks_by_channel"), &MTMidiFile::split_tracks_by_channel);
+	ClassDB::bind_static_method("MTMidiFile", D_METHOD("scan_file", "file_path"), &MTMidiFile::scan_file);
+	ClassDB::bind_static_method("MTMidiFile", D_METHOD("scan_bytes", "bytes"), &MTMidiFile::scan_bytes);
+
+	ADD_SIGNAL(MethodInfo("save_completed", PropertyInfo(Variant::STRING, "file_path"), PropertyInfo(Variant::INT, "error")));
 }
 
 MTMidiFile::MTMidiFile(){}
 
 MTMidiFile::~MTMidiFile()
 {
-    for (KeyValue<uint32_t, MTMidiTrack*> element : tracks)
-    {
-        memdelete(element.value);
-    }
-
+    clear_tracks();
+    clear_seek_index();
+    clear_note_index();
     //memdelete(playable_list);
 }
 
 bool MTMidiFile::read_file(String file_path)
 {
     bool success = true;
+    clear_seek_index();
+    clear_note_index();
+    clear_tracks();
     MTMidiFileStream file_stream;
     last_error = file_stream.open_to_read(file_path);
     if (last_error == Error::OK)
@@ -34,30 +65,51 @@ bool MTMidiFile::read_file(String file_path)
         // Set file name
         update_file_name(file_path);
 
-        if (process_file_header(file_stream))
+        if (file_stream.get_length_bytes() > limits.max_file_size)
         {
+            last_error = Error::ERR_PARAMETER_RANGE_ERROR;
+            success = false;
+            WARN_PRINT_ED(vformat("File exceeds the parsing limits: %d bytes", file_stream.get_length_bytes()));
+        }
+        else if (process_file_header(file_stream))
+        {
+            if (track_count > limits.max_tracks)
+            {
+                last_error = Error::ERR_PARAMETER_RANGE_ERROR;
+                success = false;
+                WARN_PRINT_ED(vformat("File exceeds the parsing limits: %d tracks", track_count));
+            }
+
+            uint64_t event_count = 0;
             for (int current_track = 0; current_track < track_count && (last_error == Error::OK); ++current_track)
             {
-                MTMidiTrack *track = MTMidiTrack::read_track(file_stream, current_track, last_error);
+                MTMidiTrack *track = MTMidiTrack::read_track(file_stream, current_track, &arena, last_error,
+                                                             limits, limits.max_events - event_count);
 
                 if (last_error == Error::OK)
                 {
-                    if (track->TrackMsgs().size() > 0)
+                    // Chunks that are not tracks give no track
+                    if ((track != nullptr) && (track->get_event_count() > 0))
                     {
+                        event_count += track->get_event_count();
                         tracks.insert(current_track, track);
                     }
+                    else if (track != nullptr)
+                    {
+                        memdelete(track);
+                    }
                 }
                 else
                 {
                     success = false;
-                    WARN_PRINT_ED(vformat("Error reading track: %s", file_stream.ErrorMsgs[last_error]));
+                    WARN_PRINT_ED(vformat("Error reading track: %s", MTMidiFileStream::get_error_text(last_error)));
                 }
             }
         }
         else
         {
             success = false;
-            WARN_PRINT_ED(vformat("Error reading file header: %s", file_stream.ErrorMsgs[last_error]));
+            WARN_PRINT_ED(vformat("Error reading file header: %s", MTMidiFileStream::get_error_text(last_error)));
         }
 
         file_stream.close_file();
@@ -65,7 +117,7 @@ bool MTMidiFile::read_file(String file_path)
     else
     {
         // Error, could not open file
-        WARN_PRINT_ED(vformat("Could not open file: %s : Error - %s", file_path, file_stream.ErrorMsgs[last_error]));
+        WARN_PRINT_ED(vformat("Could not open file: %s : Error - %s", file_path, MTMidiFileStream::get_error_text(last_error)));
         success = false;
     }
     return success;
@@ -80,9 +132,7 @@ bool MTMidiFile::write_file(String file_path, bool overwrite)
     if (last_error == Error::OK)
     {
         MIDIChunkHeader header(MIDIChunkHeader::HeaderType::File, 6);
-        success = header.set_format(file_format) &&
-                  header.set_track_count(track_count) &&
-                  header.set_division(ticks_per_quarter);
+        success = build_file_header(header);
 
         if (success)
         {
@@ -93,16 +143,17 @@ bool MTMidiFile::write_file(String file_path, bool overwrite)
         {
             for (KeyValue<uint32_t, MTMidiTrack*> element : tracks)
             {
-                MTMidiTrack *track = element.value;
-                MIDIChunkHeader track_header(MIDIChunkHeader::HeaderType::Track, track->get_length_in_bytes());
+                // Tracks not edited since they were last saved are not encoded again
+                PackedByteArray data = element.value->get_chunk_data();
+                MIDIChunkHeader track_header(MIDIChunkHeader::HeaderType::Track, data.size());
 
                 last_error = file_stream.write_chunk_header(track_header);
 
-                if (last_error == Error::OK)
+                if ((last_error == Error::OK) && (data.size() > 0))
                 {
-                    last_error = track->write_events_to_stream(file_stream);
-                    success = last_error == Error::OK;
+                    last_error = file_stream.write_bytes(data);
                 }
+                success = last_error == Error::OK;
 
                 if (!success)
                 {
@@ -111,6 +162,12 @@ bool MTMidiFile::write_file(String file_path, bool overwrite)
             }
         }
 
+        // Buffered data is written here, so write errors show up
+        if (success && (last_error == Error::OK))
+        {
+            last_error = file_stream.flush();
+            success = last_error == Error::OK;
+        }
         file_stream.close_file();
 
         if (success)
@@ -127,19 +184,34 @@ bool MTMidiFile::write_file(String file_path, bool overwrite)
         }
         else
         {
-            WARN_PRINT_ED(vformat("Error writing file: %s", file_stream.ErrorMsgs[last_error]));
+            WARN_PRINT_ED(vformat("Error writing file: %s", MTMidiFileStream::get_error_text(last_error)));
         }
     }
 
     return success;
 }
 
-bool MTMidiFile::process_file_header(MTMidiFileStream fileStream)
+bool MTMidiFile::process_file_header(MTMidiFileStream &fileStream)
 {
-    bool success = true;
     MIDIChunkHeader chunk_header(MIDIChunkHeader::HeaderType::Unknown, 0);
     last_error = fileStream.read_chunk_header(chunk_header);
-    if ((last_error == Error::OK) && (chunk_header.chunk_type == MIDIChunkHeader::HeaderType::File))
+    if (last_error != Error::OK)
+    {
+        // Error, unrecognized file header
+        WARN_PRINT_ED(vformat("Error reading MIDI file header: %s", MTMidiFileStream::get_error_text(last_error)));
+        return false;
+    }
+    return apply_file_header(chunk_header);
+}
+
+/// @brief Sets format, track count and timing from an MThd chunk
+/// @param chunk_header MIDIChunkHeader, File type header with its data
+/// @return bool, false if the header is not a supported MThd chunk
+bool MTMidiFile::apply_file_header(MIDIChunkHeader &chunk_header)
+{
+    bool success = true;
+    last_error = Error::OK;
+    if (chunk_header.chunk_type == MIDIChunkHeader::HeaderType::File)
     {
         if (chunk_header.chunk_length != 6)
         {
@@ -153,9 +225,11 @@ bool MTMidiFile::process_file_header(MTMidiFileStream fileStream)
             uint16_t division = chunk_header.get_division();
             if ((format != 0) && (format != 1))
             {
-                WARN_PRINT_ED(vformat("Unexpected file format: %d", file_format));
+                WARN_PRINT_ED(vformat("Unexpected file format: %d", format));
                 success = false;
             }
+            file_format = format;
+            track_count = chunk_header.get_track_count();
 
             // Read division type and values
             if (((division >> 8) & 0x80) == 0)
@@ -178,12 +252,169 @@ bool MTMidiFile::process_file_header(MTMidiFileStream fileStream)
     else
     {
         // Error, unrecognized file header
-        WARN_PRINT_ED(vformat("Error reading MIDI file header: %s", fileStream.ErrorMsgs[last_error]));
+        WARN_PRINT_ED("MIDI file does not start with an MThd chunk");
+        last_error = Error::ERR_FILE_UNRECOGNIZED;
         success = false;
     }
+
+    if (!success && (last_error == Error::OK))
+    {
+        last_error = Error::ERR_FILE_CORRUPT;
+    }
     return success;
 }
 
+/// @brief Sets the data of an MThd chunk from the format, tracks and timing
+/// Used by write_file() and save_async(), so both write the same header.
+/// @param chunk_header MIDIChunkHeader, File type header of length 6
+/// @return bool, false if the file has more tracks than an MThd chunk holds
+bool MTMidiFile::build_file_header(MIDIChunkHeader &chunk_header) const
+{
+    if (tracks.size() > 0xFFFF)
+    {
+        return false;
+    }
+    uint16_t division = smpte_format != 0 ? ((uint8_t)smpte_format << 8) | ticks_per_frame : ticks_per_quarter;
+    return chunk_header.set_format(file_format) &&
+           chunk_header.set_track_count(tracks.size()) &&
+           chunk_header.set_division(division);
+}
+
+/// @brief Reads a file written by write_cache()
+/// Restores tracks, messages, track metadata and the tempo map without
+/// decoding any MIDI data.
+/// @param file_path String, path of the cache file
+/// @return bool, true on success, see get_last_error() otherwise
+bool MTMidiFile::read_cache(String file_path)
+{
+    clear_seek_index();
+    clear_note_index();
+    clear_tracks();
+    last_error = MTMidiCache::read(this, file_path);
+    if (last_error != Error::OK)
+    {
+        clear_tracks();
+        WARN_PRINT_ED(vformat("Could not read MIDI cache file: %s : Error %d", file_path, last_error));
+        return false;
+    }
+    update_file_name(file_path);
+    return true;
+}
+
+/// @brief Writes the decoded file to a cache file
+/// Updates the tempo map before writing.
+/// @param file_path String, path of the cache file
+/// @param overwrite bool, replace an existing file
+/// @return bool, true on success, see get_last_error() otherwise
+bool MTMidiFile::write_cache(String file_path, bool overwrite)
+{
+    if (FileAccess::file_exists(file_path) && !overwrite)
+    {
+        last_error = Error::ERR_ALREADY_EXISTS;
+    }
+    else
+    {
+        last_error = MTMidiCache::write(this, file_path);
+    }
+
+    if (last_error != Error::OK)
+    {
+        WARN_PRINT_ED(vformat("Could not write MIDI cache file: %s : Error %d", file_path, last_error));
+        return false;
+    }
+    return true;
+}
+
+/// @brief Collects the Set Tempo messages of all tracks into 'tempo_map'
+/// The map is sorted by tick, a tempo change at tick 0 is always present.
+void MTMidiFile::update_tempo_map()
+{
+    tempo_map.clear();
+    for (KeyValue<uint32_t, MTMidiTrack*> element : tracks)
+    {
+        for (const MTMidiEvent &event : element.value->get_events())
+        {
+            if (event.is_meta_msg(MTMidiMsg::MetaMsgType::SetTempo) && (event.length == 6))
+            {
+                tempo_map.push_back({ event.tick, (uint32_t)((event.bytes[3] << 16) | (event.bytes[4] << 8) | event.bytes[5]) });
+            }
+        }
+    }
+
+    finish_tempo_map(tempo_map);
+}
+
+/// @brief Sorts tempo changes by tick, adding the default tempo at tick 0 if needed
+/// @param changes Vector of TempoChange to sort
+void MTMidiFile::finish_tempo_map(Vector<TempoChange> &changes)
+{
+    struct TickOrder {
+        bool operator()(const TempoChange &a, const TempoChange &b) const { return a.tick < b.tick; }
+    };
+    changes.sort_custom<TickOrder>();
+
+    if (changes.is_empty() || (changes[0].tick > 0))
+    {
+        // Default tempo, 120 bpm
+        changes.insert(0, { 0, 500000 });
+    }
+}
+
+/// @brief Converts a tick to seconds, using the tempo map
+/// @param tick int64_t, tick to convert
+/// @return double, seconds from the start of the file
+double MTMidiFile::tick_to_seconds(int64_t tick)
+{
+    if (smpte_format != 0)
+    {
+        return tick * usecs_per_tick / 1000000.0;
+    }
+
+    if (tempo_map.is_empty())
+    {
+        update_tempo_map();
+    }
+
+    return seconds_at_tick(tempo_map, ticks_per_quarter, tick);
+}
+
+/// @brief Converts a tick to seconds, using a tempo map from finish_tempo_map()
+/// @param changes Vector of TempoChange, sorted by tick
+/// @param ticks_per_quarter uint16_t, file division
+/// @param tick int64_t, tick to convert
+/// @return double, seconds from the start of the file
+double MTMidiFile::seconds_at_tick(const Vector<TempoChange> &changes, uint16_t ticks_per_quarter, int64_t tick)
+{
+    double usecs = 0.0;
+    for (int64_t i = 0; i < changes.size(); ++i)
+    {
+        const TempoChange &change = changes[i];
+        if ((int64_t)change.tick >= tick)
+        {
+            break;
+        }
+        int64_t end = ((i + 1 < changes.size()) && ((int64_t)changes[i + 1].tick < tick)) ?
+                      changes[i + 1].tick : tick;
+        usecs += (double)(end - change.tick) * change.usecs_per_quarter / ticks_per_quarter;
+    }
+    return usecs / 1000000.0;
+}
+
+/// @brief Deletes all tracks and the tempo map
+void MTMidiFile::clear_tracks()
+{
+    // Snapshots and a save in progress refer to message bytes in the arena
+    wait_for_save();
+    clear_snapshots();
+    for (KeyValue<uint32_t, MTMidiTrack*> element : tracks)
+    {
+        memdelete(element.value);
+    }
+    tracks.clear();
+    tempo_map.clear();
+    arena.clear();
+}
+
 void MTMidiFile::update_file_name(String file_path)
 {
     file_path_full = file_path;
@@ -199,6 +430,224 @@ void MTMidiFile::mark_all_tracks_saved()
     }
 }
 
+void MTMidiFile::clear_seek_index()
+{
+    if (seek_index != nullptr)
+    {
+        memdelete(seek_index);
+        seek_index = nullptr;
+    }
+}
+
+void MTMidiFile::clear_note_index()
+{
+    if (note_index != nullptr)
+    {
+        memdelete(note_index);
+        note_index = nullptr;
+    }
+}
+
+/// @brief Builds the index used by seek()
+/// Must be called again after tracks or messages have been changed.
+/// @param checkpoint_interval int, merged message count between checkpoints,
+///                            lower values make seeking faster but use more memory
+/// @return bool, true if the file contains any messages
+bool MTMidiFile::build_seek_index(int checkpoint_interval)
+{
+    clear_seek_index();
+    seek_index = memnew(MTMidiSeekIndex(tracks, checkpoint_interval > 0 ? checkpoint_interval : 256));
+    return seek_index->get_checkpoint_count() > 0;
+}
+
+/// @brief Finds the playback position at a tick and the channel state to chase
+/// Builds the seek index on first use.  The returned Dictionary contains:
+///   "tick": the tick sought to,
+///   "positions": Dictionary of track id -> index of the first message to play,
+///   "msg_count", "indices", "data": messages restoring programs, controllers,
+///   pitch bend and pressure, in the format of MTFluidSynthNode.synth_play_messages
+/// @param tick int64_t, tick to seek to
+/// @return Dictionary, empty if the file contains no messages
+Dictionary MTMidiFile::seek(int64_t tick)
+{
+    Dictionary result;
+    if ((seek_index == nullptr) && !build_seek_index())
+    {
+        WARN_PRINT_ED("No messages to seek in");
+        return result;
+    }
+
+    MTMidiSeekIndex::Cursor cursor;
+    MTMidiChaseState state;
+    if (!seek_index->seek(tick > 0 ? tick : 0, cursor, state))
+    {
+        return result;
+    }
+
+    Dictionary positions;
+    const Vector<uint32_t> &track_ids = seek_index->get_track_ids();
+    for (int32_t slot = 0; slot < track_ids.size(); ++slot)
+    {
+        positions[track_ids[slot]] = cursor.positions[slot];
+    }
+
+    PackedInt32Array indices;
+    PackedByteArray data;
+    int32_t msg_count = state.append_msgs(indices, data);
+
+    result["tick"] = tick;
+    result["positions"] = positions;
+    result["msg_count"] = msg_count;
+    result["indices"] = indices;
+    result["data"] = data;
+    return result;
+}
+
+/// @brief Returns the notes of a track as matched Note On/Off pairs
+/// The spans are in Note On order, as parallel arrays:
+///   "start_ticks": PackedInt64Array, tick of the Note On
+///   "end_ticks": PackedInt64Array, tick of the Note Off, or of the last
+///                message of the track for notes that are never released
+///   "channels": PackedByteArray
+///   "keys": PackedByteArray
+///   "velocities": PackedByteArray, Note On velocity
+/// @param track_id int32_t, id of the track
+/// @return Dictionary, empty if the track does not exist
+Dictionary MTMidiFile::get_note_spans(int32_t track_id)
+{
+    Dictionary result;
+    if (!tracks.has(track_id))
+    {
+        WARN_PRINT_ED(vformat("No track with id %d", track_id));
+        return result;
+    }
+
+    const Vector<MTMidiTrack::NoteSpan> &spans = tracks[track_id]->get_note_spans();
+    int64_t count = spans.size();
+    PackedInt64Array start_ticks;
+    PackedInt64Array end_ticks;
+    PackedByteArray channels;
+    PackedByteArray keys;
+    PackedByteArray velocities;
+    start_ticks.resize(count);
+    end_ticks.resize(count);
+    channels.resize(count);
+    keys.resize(count);
+    velocities.resize(count);
+
+    int64_t *start_ptr = start_ticks.ptrw();
+    int64_t *end_ptr = end_ticks.ptrw();
+    uint8_t *channel_ptr = channels.ptrw();
+    uint8_t *key_ptr = keys.ptrw();
+    uint8_t *velocity_ptr = velocities.ptrw();
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const MTMidiTrack::NoteSpan &span = spans[i];
+        start_ptr[i] = span.start_tick;
+        end_ptr[i] = span.end_tick;
+        channel_ptr[i] = span.channel;
+        key_ptr[i] = span.key;
+        velocity_ptr[i] = span.velocity;
+    }
+
+    result["start_ticks"] = start_ticks;
+    result["end_ticks"] = end_ticks;
+    result["channels"] = channels;
+    result["keys"] = keys;
+    result["velocities"] = velocities;
+    return result;
+}
+
+/// @brief Builds the index used by query_notes()
+/// Must be called again after tracks or messages have been changed.
+/// @param track_id int32_t, track to index, -1 for all tracks
+/// @return bool, true if any notes were indexed
+bool MTMidiFile::build_note_index(int32_t track_id)
+{
+    clear_note_index();
+    note_index = memnew(MTMidiNoteIndex);
+    if (track_id < 0)
+    {
+        for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+        {
+            note_index->add_track(element.key, element.value);
+        }
+    }
+    else if (tracks.has(track_id))
+    {
+        note_index->add_track(track_id, tracks[track_id]);
+    }
+    else
+    {
+        WARN_PRINT_ED(vformat("No track with id %d", track_id));
+    }
+    note_index->finish();
+    return note_index->get_note_count() > 0;
+}
+
+/// @brief Finds the notes sounding between two ticks
+/// Builds a note index over all tracks on first use, see build_note_index().
+/// A note sounds when it starts before 'to_tick' and ends after 'from_tick',
+/// an empty range finds the notes sounding at 'from_tick'.  The notes are returned in start order, as parallel arrays:
+///   "start_ticks": PackedInt64Array
+///   "end_ticks": PackedInt64Array
+///   "keys": PackedByteArray
+///   "velocities": PackedByteArray
+///   "channels": PackedByteArray
+///   "track_ids": PackedInt32Array
+/// @param from_tick int64_t, first tick of the range
+/// @param to_tick int64_t, tick after the range
+/// @return Dictionary
+Dictionary MTMidiFile::query_notes(int64_t from_tick, int64_t to_tick)
+{
+    if (note_index == nullptr)
+    {
+        build_note_index();
+    }
+
+    Vector<int32_t> indices;
+    int64_t count = note_index->query(from_tick > 0 ? from_tick : 0, to_tick > 0 ? to_tick : 0, indices);
+
+    PackedInt64Array start_ticks;
+    PackedInt64Array end_ticks;
+    PackedByteArray keys;
+    PackedByteArray velocities;
+    PackedByteArray channels;
+    PackedInt32Array track_ids;
+    start_ticks.resize(count);
+    end_ticks.resize(count);
+    keys.resize(count);
+    velocities.resize(count);
+    channels.resize(count);
+    track_ids.resize(count);
+
+    int64_t *start_ptr = start_ticks.ptrw();
+    int64_t *end_ptr = end_ticks.ptrw();
+    uint8_t *key_ptr = keys.ptrw();
+    uint8_t *velocity_ptr = velocities.ptrw();
+    uint8_t *channel_ptr = channels.ptrw();
+    int32_t *track_ptr = track_ids.ptrw();
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const MTMidiNoteIndex::Note &note = note_index->get_note(indices[i]);
+        start_ptr[i] = note.start_tick;
+        end_ptr[i] = note.end_tick;
+        key_ptr[i] = note.key;
+        velocity_ptr[i] = note.velocity;
+        channel_ptr[i] = note.channel;
+        track_ptr[i] = note.track_id;
+    }
+
+    Dictionary result;
+    result["start_ticks"] = start_ticks;
+    result["end_ticks"] = end_ticks;
+    result["keys"] = keys;
+    result["velocities"] = velocities;
+    result["channels"] = channels;
+    result["track_ids"] = track_ids;
+    return result;
+}
+
 MTMidiMsgList* MTMidiFile::build_playable_msg_list()
 {
 /*    bool success = true;
@@ -1,47 +1,129 @@
 #ifndef MT_MIDI_FILE_H
 #define MT_MIDI_FILE_H
 
-#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/templates/hash_map.hpp>
 #include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include "mt_midi_arena.hpp"
 #include "mt_midi_file_stream.hpp"
 #include "mt_midi_track.hpp"
 #include "mt_midi_msg.hpp"
 #include "mt_midi_msg_list.hpp"
+#include "mt_midi_note_index.hpp"
+#include "mt_midi_seek_index.hpp"
+#include "mt_smf_file.hpp"
 
 namespace godot {
 
-class MTMidiFile : public Node {
-    GDCLASS(MTMidiFile, Node)
+class MTMidiFile : public Resource {
+    GDCLASS(MTMidiFile, Resource)
 
     //MTMidiMsgList *playable_list;
+    MTMidiSeekIndex *seek_index = nullptr;
+    MTMidiNoteIndex *note_index = nullptr;
+
+    // Tracks at one point of editing, in track order
+    struct Snapshot {
+        Vector<uint32_t> track_ids;
+        Vector<MTMidiTrack::Snapshot> tracks;
+        uint16_t track_count;
+        uint16_t file_format;
+    };
+    HashMap<int64_t, Snapshot> snapshots;
+    int64_t next_snapshot_id = 1;
+
+    // A save_async() in progress.  The tracks are snapshots, so they can be
+    // encoded on a worker thread while the file is edited.
+    struct SaveJob {
+        Ref<Resource> owner;        // Keeps the file alive until the save is finished
+        uint64_t id;
+        String file_path;
+        CharString native_path;
+        PackedByteArray header_data;    // MThd chunk data, see build_file_header()
+        Vector<uint32_t> track_ids;
+        Vector<MTMidiTrack::Snapshot> tracks;
+        Vector<PackedByteArray> chunks;     // Chunk data per track, empty until encoded
+        Error result = Error::OK;
+    };
+    SaveJob *save_job = nullptr;
+    int64_t save_task_id = -1;
+    uint64_t save_count = 0;
     
     protected:
 	static void _bind_methods();
-    bool process_file_header(MTMidiFileStream file_stream);
+    bool process_file_header(MTMidiFileStream &file_stream);
     void mark_all_tracks_saved();
+    void clear_seek_index();
+    void clear_note_index();
+    void clear_tracks();
+    void save_task();
+    void finish_save(uint64_t save_id);
+    void append_end_of_track(MTMidiTrack *track, uint64_t tick);
+    void replace_tracks(const Vector<MTMidiTrack*> &new_tracks, uint16_t format);
 
     public:
+    struct TempoChange {
+        uint64_t tick;
+        uint32_t usecs_per_quarter;
+    };
+
     HashMap<uint32_t, MTMidiTrack*> tracks;
+    MTMidiArena arena;          // Message bytes of all tracks
+    Vector<TempoChange> tempo_map;
     uint16_t ticks_per_quarter = 384;
-    double usecs_per_tick;
+    double usecs_per_tick = 500000.0 / 384;
     uint16_t file_format = 1;
     uint16_t track_count = 0;
     int8_t smpte_format = 0;
     uint8_t ticks_per_frame = 0;
     String file_path_full;
     String file_name;
-    Error last_error;
+    Error last_error = Error::OK;
+    mtcore::SmfLimits limits;   // Caps applied by read_file() and MTMidiStreamParser
 
     MTMidiFile();
     ~MTMidiFile();
 
     bool read_file(String file_path);
     bool write_file(String file_path, bool overwrite);
+    bool save_async(String file_path, bool overwrite);
+    bool is_saving() { return save_job != nullptr; }
+    Error wait_for_save();
+    bool read_cache(String file_path);
+    bool write_cache(String file_path, bool overwrite);
+    bool apply_file_header(MIDIChunkHeader &chunk_header);
+    bool build_file_header(MIDIChunkHeader &chunk_header) const;
     void update_file_name(String file_path);
     MTMidiMsgList* build_playable_msg_list();
     Error get_last_error() { return last_error; }
+    void set_strict_parsing(bool strict) { limits = strict ? mtcore::SmfLimits::strict() : mtcore::SmfLimits(); }
+    bool is_strict_parsing() { return limits.max_file_size != UINT64_MAX; }
+    bool build_seek_index(int checkpoint_interval = 256);
+    Dictionary seek(int64_t tick);
+    void update_tempo_map();
+    double tick_to_seconds(int64_t tick);
+    Dictionary get_note_spans(int32_t track_id);
+    bool build_note_index(int32_t track_id = -1);
+    Dictionary query_notes(int64_t from_tick, int64_t to_tick);
+    Dictionary get_track_events(int32_t track_id);
+    Dictionary get_merged_events();
+    bool set_track_events(int32_t track_id, const PackedInt64Array &ticks, const PackedByteArray &statuses,
+                          const PackedInt32Array &offsets, const PackedByteArray &data);
+    int64_t insert_event(int32_t track_id, int64_t tick, int32_t status, const PackedByteArray &data);
+    bool remove_event(int32_t track_id, int64_t index);
+    int64_t create_snapshot();
+    bool restore_snapshot(int64_t snapshot_id);
+    void free_snapshot(int64_t snapshot_id);
+    void clear_snapshots();
+    bool merge_tracks();
+    bool split_tracks_by_channel();
+
+    static void finish_tempo_map(Vector<TempoChange> &changes);
+    static double seconds_at_tick(const Vector<TempoChange> &changes, uint16_t ticks_per_quarter, int64_t tick);
+    static Dictionary scan_file(String file_path);
+    static Dictionary scan_bytes(const PackedByteArray &bytes);
 };
 }
 #endif
@@ -0,0 +1,132 @@
+#include "mt_midi_file.hpp"
+#include "mt_midi_track_merger.hpp"
+#include <godot_cpp/core/error_macros.hpp>
+
+using namespace godot;
+
+/// @brief Appends an End of Track message, with its bytes in the arena
+/// @param track Pointer to the MTMidiTrack, messages up to 'tick'
+/// @param tick uint64_t, tick of the message
+void MTMidiFile::append_end_of_track(MTMidiTrack *track, uint64_t tick)
+{
+    static const uint8_t end_of_track[3] = { 0xFF, MTMidiMsg::MetaMsgType::EndOfTrack, 0x00 };
+    uint8_t channel_prefix = 0;
+    uint8_t port_prefix = 0;
+    MTMidiEvent event;
+    MTMidiMsg::init_event(arena.store(end_of_track, 3), 3, channel_prefix, port_prefix, event);
+    event.tick = tick;
+    track->append_event(event);
+}
+
+/// @brief Replaces all tracks by new ones, as converting the format does
+/// Indexes built by build_seek_index() and build_note_index() are dropped
+/// and the tempo map is rebuilt when next needed.  The message bytes stay in
+/// the arena, so snapshots can still be restored.
+/// @param new_tracks Vector of tracks, taking track ids 0 and up
+/// @param format uint16_t, new file format
+void MTMidiFile::replace_tracks(const Vector<MTMidiTrack*> &new_tracks, uint16_t format)
+{
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        memdelete(element.value);
+    }
+    tracks.clear();
+    for (int32_t slot = 0; slot < new_tracks.size(); ++slot)
+    {
+        new_tracks[slot]->track_id = slot;
+        new_tracks[slot]->contains_unsaved_edits = true;
+        tracks.insert(slot, new_tracks[slot]);
+    }
+    file_format = format;
+    track_count = tracks.size();
+
+    clear_seek_index();
+    clear_note_index();
+    tempo_map.clear();
+    last_error = Error::OK;
+}
+
+/// @brief Converts the file to format 0: all tracks are merged into one
+/// Messages at the same tick keep the track order.  The End of Track
+/// messages of the tracks are replaced by one at the last tick.
+/// @return bool, true on success
+bool MTMidiFile::merge_tracks()
+{
+    if (tracks.is_empty())
+    {
+        WARN_PRINT_ED("No tracks to convert");
+        last_error = Error::ERR_DOES_NOT_EXIST;
+        return false;
+    }
+
+    MTMidiTrack *merged = memnew(MTMidiTrack(0, &arena));
+    MTMidiTrackMerger merger(tracks);
+    const MTMidiEvent *event;
+    while ((event = merger.next()) != nullptr)
+    {
+        if (!event->is_meta_msg(MTMidiMsg::MetaMsgType::EndOfTrack))
+        {
+            merged->append_event(*event);
+        }
+    }
+    append_end_of_track(merged, merger.get_end_tick());
+
+    Vector<MTMidiTrack*> new_tracks;
+    new_tracks.push_back(merged);
+    replace_tracks(new_tracks, 0);
+    return true;
+}
+
+/// @brief Converts the file to format 1 with one track per MIDI channel
+/// Track 0 receives the meta and sysex messages, followed by a track for
+/// every channel used, in channel order.  Files with several tracks are
+/// merged first, so any file can be split.  Every track ends with an End of
+/// Track message at the last tick of the file.
+/// @return bool, true on success
+bool MTMidiFile::split_tracks_by_channel()
+{
+    if (tracks.is_empty())
+    {
+        WARN_PRINT_ED("No tracks to convert");
+        last_error = Error::ERR_DOES_NOT_EXIST;
+        return false;
+    }
+
+    MTMidiTrack *conductor = memnew(MTMidiTrack(0, &arena));
+    MTMidiTrack *channel_tracks[16] = {};
+    MTMidiTrackMerger merger(tracks);
+    const MTMidiEvent *event;
+    while ((event = merger.next()) != nullptr)
+    {
+        if (event->is_channel_msg())
+        {
+            uint8_t channel = event->bytes[0] & 0x0F;
+            if (channel_tracks[channel] == nullptr)
+            {
+                channel_tracks[channel] = memnew(MTMidiTrack(channel + 1, &arena));
+            }
+            channel_tracks[channel]->append_event(*event);
+        }
+        else if (!event->is_meta_msg(MTMidiMsg::MetaMsgType::EndOfTrack))
+        {
+            conductor->append_event(*event);
+        }
+    }
+
+    Vector<MTMidiTrack*> new_tracks;
+    new_tracks.push_back(conductor);
+    for (MTMidiTrack *track : channel_tracks)
+    {
+        if (track != nullptr)
+        {
+            new_tracks.push_back(track);
+        }
+    }
+    for (MTMidiTrack *track : new_tracks)
+    {
+        append_end_of_track(track, merger.get_end_tick());
+    }
+
+    replace_tracks(new_tracks, 1);
+    return true;
+}
@@ -0,0 +1,181 @@
+#include "mt_midi_file.hpp"
+#include <godot_cpp/core/error_macros.hpp>
+
+using namespace godot;
+
+/// @brief Inserts a message into a track, after the messages with the same tick
+/// The message goes before the End of Track message ending the track, which
+/// moves to the tick of the message if needed; End of Track messages can
+/// not be inserted.  The message gets the channel and port prefixes in
+/// effect at its position.  Indexes built by build_seek_index() and
+/// build_note_index() are dropped.
+/// @param track_id int32_t, id of the track
+/// @param tick int64_t, absolute tick of the message
+/// @param status int32_t, status byte
+/// @param data PackedByteArray, data bytes of a channel message, type and
+///             payload of a meta message, or payload of a sysex message
+/// @return int64_t, index of the message in the track, -1 on error
+int64_t MTMidiFile::insert_event(int32_t track_id, int64_t tick, int32_t status, const PackedByteArray &data)
+{
+    if (!tracks.has(track_id))
+    {
+        WARN_PRINT_ED(vformat("No track with id %d", track_id));
+        last_error = Error::ERR_INVALID_PARAMETER;
+        return -1;
+    }
+
+    int64_t length = (tick >= 0) && (status >= 0) && (status <= 0xFF) ?
+        MTMidiMsg::get_encoded_length(status, data.ptr(), data.size()) : -1;
+    if (length < 0)
+    {
+        WARN_PRINT_ED("Invalid MIDI message");
+        last_error = Error::ERR_INVALID_PARAMETER;
+        return -1;
+    }
+
+    if ((status == 0xFF) && (data[0] == MTMidiMsg::MetaMsgType::EndOfTrack))
+    {
+        WARN_PRINT_ED("End of Track messages can not be inserted, every track ends with one");
+        last_error = Error::ERR_INVALID_PARAMETER;
+        return -1;
+    }
+
+    MTMidiTrack *track = tracks[track_id];
+    uint8_t *bytes = arena.allocate(length);
+    MTMidiMsg::encode_msg(status, data.ptr(), data.size(), bytes);
+    uint8_t channel_prefix;
+    uint8_t port_prefix;
+    track->get_prefixes_at(track->find_insert_index(tick), channel_prefix, port_prefix);
+    MTMidiEvent event;
+    MTMidiMsg::init_event(bytes, length, channel_prefix, port_prefix, event);
+    event.tick = tick;
+
+    clear_seek_index();
+    clear_note_index();
+    if (event.is_meta_msg(MTMidiMsg::MetaMsgType::SetTempo))
+    {
+        tempo_map.clear();
+    }
+    last_error = Error::OK;
+    return track->insert_event(event);
+}
+
+/// @brief Removes a message from a track
+/// The End of Track message ending the track can not be removed.
+/// Indexes built by build_seek_index() and build_note_index() are dropped.
+/// @param track_id int32_t, id of the track
+/// @param index int64_t, index of the message in the track
+/// @return bool, false if there is no such message
+bool MTMidiFile::remove_event(int32_t track_id, int64_t index)
+{
+    if (tracks.has(track_id) && tracks[track_id]->ends_with_end_of_track() &&
+        (index == tracks[track_id]->get_event_count() - 1))
+    {
+        WARN_PRINT_ED(vformat("Message %d ends track %d and can not be removed", index, track_id));
+        last_error = Error::ERR_INVALID_PARAMETER;
+        return false;
+    }
+
+    if (!tracks.has(track_id) || !tracks[track_id]->remove_event(index))
+    {
+        WARN_PRINT_ED(vformat("No message %d in track %d", index, track_id));
+        last_error = Error::ERR_INVALID_PARAMETER;
+        return false;
+    }
+
+    clear_seek_index();
+    clear_note_index();
+    tempo_map.clear();
+    last_error = Error::OK;
+    return true;
+}
+
+/// @brief Takes a snapshot of all tracks, for undo
+/// O(1) per track: the snapshot shares its messages with the tracks, and
+/// later edits copy only the chunks of messages they change.  Snapshots are
+/// kept until freed, or until the tracks are cleared by reading a file.
+/// @return int64_t, id of the snapshot for restore_snapshot()
+int64_t MTMidiFile::create_snapshot()
+{
+    Snapshot snapshot;
+    snapshot.track_count = track_count;
+    snapshot.file_format = file_format;
+    snapshot.track_ids.resize(tracks.size());
+    snapshot.tracks.resize(tracks.size());
+    int64_t slot = 0;
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        snapshot.track_ids.write[slot] = element.key;
+        element.value->create_snapshot(snapshot.tracks.write[slot]);
+        ++slot;
+    }
+
+    int64_t snapshot_id = next_snapshot_id++;
+    snapshots.insert(snapshot_id, snapshot);
+    return snapshot_id;
+}
+
+/// @brief Returns all tracks to the state of a snapshot
+/// Tracks that did not change since the snapshot are left as they are.
+/// The snapshot is kept, so it can be restored again.
+/// @param snapshot_id int64_t, id returned by create_snapshot()
+/// @return bool, false if there is no such snapshot
+bool MTMidiFile::restore_snapshot(int64_t snapshot_id)
+{
+    if (!snapshots.has(snapshot_id))
+    {
+        WARN_PRINT_ED(vformat("No snapshot with id %d", snapshot_id));
+        last_error = Error::ERR_DOES_NOT_EXIST;
+        return false;
+    }
+
+    const Snapshot &snapshot = snapshots[snapshot_id];
+    HashMap<uint32_t, MTMidiTrack*> restored;
+    for (int64_t slot = 0; slot < snapshot.track_ids.size(); ++slot)
+    {
+        uint32_t track_id = snapshot.track_ids[slot];
+        MTMidiTrack *track;
+        if (tracks.has(track_id))
+        {
+            track = tracks[track_id];
+            tracks.erase(track_id);
+        }
+        else
+        {
+            track = memnew(MTMidiTrack(track_id, &arena));
+        }
+        track->restore_snapshot(snapshot.tracks[slot]);
+        restored.insert(track_id, track);
+    }
+
+    // Tracks added after the snapshot
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        memdelete(element.value);
+    }
+    tracks.clear();
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : restored)
+    {
+        tracks.insert(element.key, element.value);
+    }
+    track_count = snapshot.track_count;
+    file_format = snapshot.file_format;
+
+    clear_seek_index();
+    clear_note_index();
+    tempo_map.clear();
+    last_error = Error::OK;
+    return true;
+}
+
+/// @brief Frees a snapshot, messages only it refers to are released
+/// @param snapshot_id int64_t, id returned by create_snapshot()
+void MTMidiFile::free_snapshot(int64_t snapshot_id)
+{
+    snapshots.erase(snapshot_id);
+}
+
+void MTMidiFile::clear_snapshots()
+{
+    snapshots.clear();
+}
@@ -0,0 +1,212 @@
+#include "mt_midi_file.hpp"
+#include "mt_midi_track_merger.hpp"
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+
+using namespace godot;
+
+namespace {
+
+// Columns of an event export, filled in a second pass once the sizes are known
+struct EventColumns {
+    PackedInt64Array ticks;
+    PackedByteArray statuses;
+    PackedInt32Array offsets;
+    PackedByteArray data;
+    PackedInt32Array track_ids;
+    int64_t *tick_ptr;
+    uint8_t *status_ptr;
+    int32_t *offset_ptr;
+    uint8_t *data_ptr;
+    int32_t *track_ptr;
+    int32_t data_size = 0;
+
+    void allocate(int64_t count, int64_t data_length, bool with_track_ids)
+    {
+        ticks.resize(count);
+        statuses.resize(count);
+        offsets.resize(count + 1);
+        data.resize(data_length);
+        tick_ptr = ticks.ptrw();
+        status_ptr = statuses.ptrw();
+        offset_ptr = offsets.ptrw();
+        data_ptr = data.ptrw();
+        track_ptr = nullptr;
+        if (with_track_ids)
+        {
+            track_ids.resize(count);
+            track_ptr = track_ids.ptrw();
+        }
+        offset_ptr[0] = 0;
+    }
+
+    Dictionary to_dictionary() const
+    {
+        Dictionary result;
+        result["ticks"] = ticks;
+        result["statuses"] = statuses;
+        result["offsets"] = offsets;
+        result["data"] = data;
+        if (track_ptr != nullptr)
+        {
+            result["track_ids"] = track_ids;
+        }
+        return result;
+    }
+};
+
+// Bytes exported for a message after its status byte: the data bytes of
+// channel messages, the type and payload of meta messages, the payload of
+// sysex messages.  The length of meta and sysex payloads is left out, it
+// follows from the offsets.
+uint32_t export_data_length(const MTMidiEvent &event)
+{
+    if (event.bytes[0] < MTMidiMsg::ChannelMsgType::NonChannel)
+    {
+        return event.length - 1;
+    }
+    return event.bytes[0] == MTMidiMsg::NonChMsgType::Meta ? event.data_length + 1 : event.data_length;
+}
+
+void export_event(const MTMidiEvent &event, int64_t index, EventColumns &columns)
+{
+    uint8_t *data = columns.data_ptr + columns.data_size;
+    uint32_t length = export_data_length(event);
+    if (event.bytes[0] < MTMidiMsg::ChannelMsgType::NonChannel)
+    {
+        memcpy(data, event.bytes + 1, length);
+    }
+    else if (event.bytes[0] == MTMidiMsg::NonChMsgType::Meta)
+    {
+        data[0] = event.bytes[1];
+        memcpy(data + 1, event.bytes + event.data_start, event.data_length);
+    }
+    else
+    {
+        memcpy(data, event.bytes + event.data_start, event.data_length);
+    }
+
+    columns.data_size += length;
+    columns.tick_ptr[index] = event.tick;
+    columns.status_ptr[index] = event.bytes[0];
+    columns.offset_ptr[index + 1] = columns.data_size;
+}
+
+}
+
+/// @brief Returns all messages of a track as parallel arrays
+/// Message i is made of:
+///   "ticks": PackedInt64Array, absolute tick
+///   "statuses": PackedByteArray, status byte
+///   "data": PackedByteArray, bytes from offsets[i] to offsets[i + 1]: the
+///           data bytes of channel messages, the type followed by the payload
+///           of meta messages, the payload of sysex messages
+///   "offsets": PackedInt32Array, one entry more than there are messages
+/// @param track_id int32_t, id of the track
+/// @return Dictionary, empty if the track does not exist
+Dictionary MTMidiFile::get_track_events(int32_t track_id)
+{
+    if (!tracks.has(track_id))
+    {
+        WARN_PRINT_ED(vformat("No track with id %d", track_id));
+        return Dictionary();
+    }
+
+    const MTMidiEventList &events = tracks[track_id]->get_events();
+    int64_t data_length = 0;
+    for (const MTMidiEvent &event : events)
+    {
+        data_length += export_data_length(event);
+    }
+
+    EventColumns columns;
+    columns.allocate(events.size(), data_length, false);
+    int64_t index = 0;
+    for (const MTMidiEvent &event : events)
+    {
+        export_event(event, index++, columns);
+    }
+    return columns.to_dictionary();
+}
+
+/// @brief Returns the messages of all tracks merged in tick order
+/// Same format as get_track_events(), with an additional "track_ids"
+/// PackedInt32Array.  Messages at the same tick keep the track order.
+/// @return Dictionary
+Dictionary MTMidiFile::get_merged_events()
+{
+    int64_t data_length = 0;
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        for (const MTMidiEvent &event : element.value->get_events())
+        {
+            data_length += export_data_length(event);
+        }
+    }
+
+    MTMidiTrackMerger merger(tracks);
+    EventColumns columns;
+    columns.allocate(merger.get_event_count(), data_length, true);
+
+    const MTMidiEvent *event;
+    int64_t index = 0;
+    while ((event = merger.next()) != nullptr)
+    {
+        export_event(*event, index, columns);
+        columns.track_ptr[index] = merger.get_track_id();
+        ++index;
+    }
+    return columns.to_dictionary();
+}
+
+/// @brief Replaces or adds a track, built from messages in the format of
+/// get_track_events()
+/// The messages are sorted by tick, messages with the same tick keep their
+/// order.  The track gets a single End of Track message after the last
+/// message, whether or not the arrays contain one.  Indexes built by build_seek_index() and build_note_index() are
+/// dropped and the tempo map is rebuilt when next needed.
+/// @param track_id int32_t, id of the track
+/// @param ticks PackedInt64Array, absolute tick of every message
+/// @param statuses PackedByteArray, status byte of every message
+/// @param offsets PackedInt32Array, start of every message in 'data', followed
+///                by the end of the last message
+/// @param data PackedByteArray, message data
+/// @return bool, true on success, see get_last_error() otherwise
+bool MTMidiFile::set_track_events(
+    int32_t track_id,
+    const PackedInt64Array &ticks,
+    const PackedByteArray &statuses,
+    const PackedInt32Array &offsets,
+    const PackedByteArray &data)
+{
+    if (track_id < 0)
+    {
+        WARN_PRINT_ED(vformat("Invalid track id %d", track_id));
+        last_error = Error::ERR_INVALID_PARAMETER;
+        return false;
+    }
+
+    MTMidiTrack *track = MTMidiTrack::build_track(track_id, &arena, ticks, statuses, offsets, data, last_error);
+    if (track == nullptr)
+    {
+        return false;
+    }
+
+    if (tracks.has(track_id))
+    {
+        // The bytes of the old messages stay in the arena until the file is cleared
+        memdelete(tracks[track_id]);
+        tracks[track_id] = track;
+    }
+    else
+    {
+        tracks.insert(track_id, track);
+        track_count = tracks.size();
+    }
+
+    clear_seek_index();
+    clear_note_index();
+    tempo_map.clear();
+    return true;
+}
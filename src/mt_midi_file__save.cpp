@@ -0,0 +1,184 @@
+#include "mt_midi_file.hpp"
+#include "mt_smf_file.hpp"
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+using namespace godot;
+
+/// @brief Saves the file on the WorkerThreadPool, without blocking the caller
+/// The tracks are captured like create_snapshot() does, so the file can be
+/// edited while it is saved; edits made after the call are not saved.  Only
+/// tracks edited since they were last saved are encoded again.  The
+/// file is written to a temporary file, synced and renamed over 'file_path',
+/// so it is never left partly written.  'save_completed' is emitted on the
+/// main thread once the file is saved or saving failed.  Only one save runs
+/// at a time.
+/// @param file_path String, path of the file
+/// @param overwrite bool, replace an existing file
+/// @return bool, true if saving started
+bool MTMidiFile::save_async(String file_path, bool overwrite)
+{
+    if (save_job != nullptr)
+    {
+        WARN_PRINT_ED(vformat("Still saving %s", save_job->file_path));
+        last_error = Error::ERR_BUSY;
+        return false;
+    }
+
+    if (!overwrite && FileAccess::file_exists(file_path))
+    {
+        WARN_PRINT_ED(vformat("File already exists: %s", file_path));
+        last_error = Error::ERR_ALREADY_EXISTS;
+        return false;
+    }
+
+    MIDIChunkHeader header(MIDIChunkHeader::HeaderType::File, 6);
+    if (!build_file_header(header))
+    {
+        WARN_PRINT_ED(vformat("Too many tracks to save: %d", tracks.size()));
+        last_error = Error::ERR_PARAMETER_RANGE_ERROR;
+        return false;
+    }
+
+    SaveJob *job = memnew(SaveJob);
+    job->owner = Ref<Resource>(this);
+    job->id = ++save_count;
+    job->file_path = file_path;
+    job->native_path = ProjectSettings::get_singleton()->globalize_path(file_path).utf8();
+    job->header_data = header.header_data;
+    job->track_ids.resize(tracks.size());
+    job->tracks.resize(tracks.size());
+    job->chunks.resize(tracks.size());
+    int64_t slot = 0;
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        job->track_ids.write[slot] = element.key;
+        element.value->create_snapshot(job->tracks.write[slot]);
+        element.value->get_cached_chunk_data(job->chunks.write[slot]);
+        ++slot;
+    }
+
+    save_job = job;
+    save_task_id = WorkerThreadPool::get_singleton()->add_task(callable_mp(this, &MTMidiFile::save_task),
+                                                               false, "MTMidiFile save");
+    last_error = Error::OK;
+    return true;
+}
+
+/// @brief Waits for a save_async() in progress, emitting 'save_completed'
+/// before returning
+/// @return Error, result of the save, OK if no save was in progress
+Error MTMidiFile::wait_for_save()
+{
+    if (save_job == nullptr)
+    {
+        return Error::OK;
+    }
+    finish_save(save_job->id);
+    return last_error;
+}
+
+/// @brief Encodes and writes the file of save_job, runs on the WorkerThreadPool
+/// Only this task uses the job until finish_save().  The message bytes are
+/// read from the arena, which is not cleared while a save is in progress.
+void MTMidiFile::save_task()
+{
+    SaveJob *job = save_job;
+
+    uint64_t file_length = 14;
+    for (int64_t slot = 0; slot < job->tracks.size(); ++slot)
+    {
+        const MTMidiEventList &events = job->tracks[slot].events;
+        if (job->chunks[slot].is_empty() && !events.is_empty())
+        {
+            PackedByteArray &data = job->chunks.write[slot];
+            data.resize(MTMidiTrack::measure_events(events));
+            MTMidiTrack::encode_events(events, data.ptrw());
+        }
+        file_length += 8 + job->chunks[slot].size();
+    }
+
+    PackedByteArray contents;
+    contents.resize(file_length);
+    uint8_t *ptr = contents.ptrw();
+    const uint8_t chunk_header[8] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6 };
+    memcpy(ptr, chunk_header, 8);
+    memcpy(ptr + 8, job->header_data.ptr(), 6);
+    ptr += 14;
+
+    job->result = Error::OK;
+    for (const PackedByteArray &data : job->chunks)
+    {
+        uint64_t length = data.size();
+        if (length > 0xFFFFFFFF)
+        {
+            job->result = Error::ERR_PARAMETER_RANGE_ERROR;
+            break;
+        }
+        memcpy(ptr, MIDIChunkHeader::CHUNK_TYPE_TRACK, 4);
+        for (int i = 0; i < 4; ++i)
+        {
+            ptr[4 + i] = (length >> (24 - i * 8)) & 0xFF;
+        }
+        if (length > 0)
+        {
+            memcpy(ptr + 8, data.ptr(), length);
+        }
+        ptr += 8 + length;
+    }
+
+    if (job->result == Error::OK)
+    {
+        mtcore::SmfResult result = mtcore::write_file_atomic(job->native_path.get_data(), contents.ptr(), contents.size());
+        if (result != mtcore::SmfResult::Ok)
+        {
+            job->result = result == mtcore::SmfResult::CantOpen ? Error::ERR_FILE_CANT_OPEN : Error::ERR_FILE_CANT_WRITE;
+        }
+    }
+
+    callable_mp(this, &MTMidiFile::finish_save).call_deferred(job->id);
+}
+
+/// @brief Ends a save on the main thread: marks the tracks which did not
+/// change since the save started as saved, keeps their chunk data for the
+/// next save and emits 'save_completed'
+/// @param save_id uint64_t, id of the save, calls for earlier saves are ignored
+void MTMidiFile::finish_save(uint64_t save_id)
+{
+    if ((save_job == nullptr) || (save_job->id != save_id))
+    {
+        // Already finished by wait_for_save()
+        return;
+    }
+
+    WorkerThreadPool::get_singleton()->wait_for_task_completion(save_task_id);
+    SaveJob *job = save_job;
+    save_job = nullptr;
+    save_task_id = -1;
+
+    if (job->result == Error::OK)
+    {
+        for (int64_t slot = 0; slot < job->track_ids.size(); ++slot)
+        {
+            HashMap<uint32_t, MTMidiTrack*>::Iterator element = tracks.find(job->track_ids[slot]);
+            if ((element != tracks.end()) && element->value->get_events().shares_storage(job->tracks[slot].events))
+            {
+                element->value->contains_unsaved_edits = false;
+                element->value->cache_chunk_data(job->tracks[slot].events, job->chunks[slot]);
+            }
+        }
+    }
+    else
+    {
+        WARN_PRINT_ED(vformat("Error saving file %s: %s", job->file_path, MTMidiFileStream::get_error_text(job->result)));
+    }
+
+    last_error = job->result;
+    emit_signal("save_completed", job->file_path, job->result);
+
+    // Releasing the job may free the file, so it comes last
+    Ref<Resource> owner = job->owner;
+    memdelete(job);
+}
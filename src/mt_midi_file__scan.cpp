@@ -0,0 +1,261 @@
+#include "mt_midi_file.hpp"
+#include "mt_smf_scanner.hpp"
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+
+using namespace godot;
+
+/// @brief Reads a MIDI file and summarizes it, see scan_bytes()
+/// @param file_path String, path of the MIDI file
+/// @return Dictionary, file summary
+Dictionary MTMidiFile::scan_file(String file_path)
+{
+    if (!FileAccess::file_exists(file_path))
+    {
+        Dictionary summary;
+        summary["error"] = Error::ERR_FILE_NOT_FOUND;
+        return summary;
+    }
+
+    Dictionary summary = scan_bytes(FileAccess::get_file_as_bytes(file_path));
+    summary["file_path"] = file_path;
+    return summary;
+}
+
+/// @brief Summarizes MIDI file data without creating any messages
+/// Walks all chunks and events of the file once with mtcore::SmfEventScanner,
+/// only decoding what the summary needs.  The returned Dictionary contains:
+///   "error": Error, OK if the whole file could be scanned
+///   "format", "track_count", "ticks_per_quarter", "smpte_format", "ticks_per_frame"
+///   "track_names": PackedStringArray, first track name of every track
+///   "programs": PackedInt32Array, programs used on channels other than 10
+///   "channels": int, bit per channel with channel messages
+///   "has_drums": bool, notes are played on channel 10
+///   "note_min", "note_max": int, note range on channels other than 10,
+///                           -1 without notes
+///   "note_count": int, number of notes played (Note On with velocity > 0)
+///   "total_ticks": int, tick of the last event
+///   "duration": float, length in seconds, using the tempo map
+///   "tempo": int, initial microseconds per quarter note
+///   "tempo_changes": int, number of Set Tempo messages
+///   "time_signature": PackedInt32Array, initial numerator and denominator
+///   "key_signature": PackedInt32Array, initial sharps (negative for flats)
+///                    and 1 for minor keys, empty without a key signature
+/// Fields are filled as far as the data could be scanned when an error occurs.
+/// @param bytes PackedByteArray, contents of a standard MIDI file
+/// @return Dictionary, file summary
+Dictionary MTMidiFile::scan_bytes(const PackedByteArray &bytes)
+{
+    const uint8_t *data = bytes.ptr();
+    uint64_t size = bytes.size();
+    uint64_t offset = 0;
+    Error result = Error::OK;
+
+    uint16_t format = 0;
+    uint16_t division = 0;
+    uint16_t tracks_found = 0;
+    PackedStringArray track_names;
+    uint16_t channels = 0;
+    uint16_t note_channels = 0;
+    uint64_t programs[2] = { 0, 0 };
+    int32_t note_min = -1;
+    int32_t note_max = -1;
+    int64_t note_count = 0;
+    uint64_t total_ticks = 0;
+    Vector<TempoChange> tempos;
+    int64_t first_time_sig_tick = -1;
+    PackedInt32Array time_signature;
+    int64_t first_key_sig_tick = -1;
+    PackedInt32Array key_signature;
+
+    if ((size < 14) || (memcmp(data, "MThd", 4) != 0))
+    {
+        result = Error::ERR_FILE_UNRECOGNIZED;
+    }
+    else
+    {
+        uint32_t header_length = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+        format = (data[8] << 8) | data[9];
+        division = (data[12] << 8) | data[13];
+        offset = 8 + (uint64_t)header_length;
+        if ((header_length < 6) || (offset > size))
+        {
+            result = Error::ERR_FILE_CORRUPT;
+        }
+    }
+
+    while ((result == Error::OK) && (size - offset >= 8))
+    {
+        const uint8_t *chunk = data + offset;
+        uint32_t chunk_length = (chunk[4] << 24) | (chunk[5] << 16) | (chunk[6] << 8) | chunk[7];
+        offset += 8;
+        if (chunk_length > size - offset)
+        {
+            result = Error::ERR_FILE_EOF;
+            break;
+        }
+
+        if (memcmp(chunk, "MTrk", 4) != 0)
+        {
+            // Unknown chunks are skipped
+            offset += chunk_length;
+            continue;
+        }
+
+        mtcore::SmfEventScanner scanner(data + offset, chunk_length);
+        const uint8_t *track_data = data + offset;
+        offset += chunk_length;
+        track_names.append(String());
+
+        mtcore::SmfEventScanner::Event event;
+        while (scanner.next(event))
+        {
+            const uint8_t *msg = track_data + event.data_offset;
+            uint64_t tick = event.tick;
+            uint32_t length = event.data_length;
+
+            if (event.status < MTMidiMsg::ChannelMsgType::NonChannel)
+            {
+                uint8_t ch = event.status & 0x0F;
+                channels |= 1 << ch;
+                switch (event.status & 0xF0)
+                {
+                    case MTMidiMsg::ChannelMsgType::NoteOn:
+                        if ((msg[1] & 0x7F) == 0)
+                        {
+                            break;
+                        }
+                        note_channels |= 1 << ch;
+                        ++note_count;
+                        if (ch != 9)
+                        {
+                            int32_t note = msg[0] & 0x7F;
+                            note_min = ((note_min == -1) || (note < note_min)) ? note : note_min;
+                            note_max = note > note_max ? note : note_max;
+                        }
+                        break;
+                    case MTMidiMsg::ChannelMsgType::ProgramChange:
+                        if (ch != 9)
+                        {
+                            programs[(msg[0] >> 6) & 1] |= 1ULL << (msg[0] & 0x3F);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+            else if (event.status == MTMidiMsg::NonChMsgType::Meta)
+            {
+                switch (event.meta_type)
+                {
+                    case MTMidiMsg::MetaMsgType::SeqOrTrkName:
+                        if (track_names[tracks_found].is_empty())
+                        {
+                            track_names.set(tracks_found, String::utf8((const char *)msg, length));
+                        }
+                        break;
+                    case MTMidiMsg::MetaMsgType::SetTempo:
+                        if (length == 3)
+                        {
+                            tempos.push_back({ tick, (uint32_t)((msg[0] << 16) | (msg[1] << 8) | msg[2]) });
+                        }
+                        break;
+                    case MTMidiMsg::MetaMsgType::TimeSignature:
+                        if ((length >= 2) && ((first_time_sig_tick == -1) || ((int64_t)tick < first_time_sig_tick)))
+                        {
+                            first_time_sig_tick = tick;
+                            time_signature.clear();
+                            time_signature.append(msg[0]);
+                            time_signature.append(1 << (msg[1] & 0x07));
+                        }
+                        break;
+                    case MTMidiMsg::MetaMsgType::KeySignature:
+                        if ((length >= 2) && ((first_key_sig_tick == -1) || ((int64_t)tick < first_key_sig_tick)))
+                        {
+                            first_key_sig_tick = tick;
+                            key_signature.clear();
+                            key_signature.append((int8_t)msg[0]);
+                            key_signature.append(msg[1] & 1);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        if (scanner.has_error())
+        {
+            result = Error::ERR_PARSE_ERROR;
+        }
+
+        uint64_t tick = scanner.get_tick();
+        total_ticks = tick > total_ticks ? tick : total_ticks;
+        ++tracks_found;
+    }
+
+    Dictionary summary;
+    summary["error"] = result;
+    summary["format"] = format;
+    summary["track_count"] = tracks_found;
+
+    int64_t tempo_changes = tempos.size();
+    finish_tempo_map(tempos);
+
+    int8_t smpte_format = 0;
+    uint8_t ticks_per_frame = 0;
+    uint16_t ticks_per_quarter = 0;
+    double duration = 0.0;
+    if ((division & 0x8000) != 0)
+    {
+        smpte_format = (division >> 8) & 0xFF;
+        ticks_per_frame = division & 0xFF;
+        if (ticks_per_frame > 0)
+        {
+            duration = (double)total_ticks / abs(smpte_format) / ticks_per_frame;
+        }
+    }
+    else
+    {
+        ticks_per_quarter = division;
+        if (ticks_per_quarter > 0)
+        {
+            duration = seconds_at_tick(tempos, ticks_per_quarter, total_ticks);
+        }
+    }
+    summary["ticks_per_quarter"] = ticks_per_quarter;
+    summary["smpte_format"] = smpte_format;
+    summary["ticks_per_frame"] = ticks_per_frame;
+
+    PackedInt32Array program_list;
+    for (int32_t program = 0; program < 128; ++program)
+    {
+        if ((programs[program >> 6] >> (program & 0x3F)) & 1)
+        {
+            program_list.append(program);
+        }
+    }
+
+    if (time_signature.is_empty())
+    {
+        time_signature.append(4);
+        time_signature.append(4);
+    }
+
+    summary["track_names"] = track_names;
+    summary["programs"] = program_list;
+    summary["channels"] = channels;
+    summary["has_drums"] = ((note_channels >> 9) & 1) != 0;
+    summary["note_min"] = note_min;
+    summary["note_max"] = note_max;
+    summary["note_count"] = note_count;
+    summary["total_ticks"] = total_ticks;
+    summary["duration"] = duration;
+    summary["tempo"] = tempos[0].usecs_per_quarter;
+    summary["tempo_changes"] = tempo_changes;
+    summary["time_signature"] = time_signature;
+    summary["key_signature"] = key_signature;
+    return summary;
+}
@@ -1,13 +1,113 @@
 #include "mt_midi_file_stream.hpp"
+#include "mt_smf.hpp"
+#include <godot_cpp/core/error_macros.hpp>
 #include <godot_cpp/variant/array.hpp>
+#include <utility>
 
 using namespace godot;
 
+namespace {
+
+// Names of godot::Error values, by value
+const char *const ERROR_TEXTS[] = {
+    "OK",
+    "FAILED",
+    "ERR_UNAVAILABLE",
+    "ERR_UNCONFIGURED",
+    "ERR_UNAUTHORIZED",
+    "ERR_PARAMETER_RANGE_ERROR",
+    "ERR_OUT_OF_MEMORY",
+    "ERR_FILE_NOT_FOUND",
+    "ERR_FILE_BAD_DRIVE",
+    "ERR_FILE_BAD_PATH",
+    "ERR_FILE_NO_PERMISSION",
+    "ERR_FILE_ALREADY_IN_USE",
+    "ERR_FILE_CANT_OPEN",
+    "ERR_FILE_CANT_WRITE",
+    "ERR_FILE_CANT_READ",
+    "ERR_FILE_UNRECOGNIZED",
+    "ERR_FILE_CORRUPT",
+    "ERR_FILE_MISSING_DEPENDENCIES",
+    "ERR_FILE_EOF",
+    "ERR_CANT_OPEN",
+    "ERR_CANT_CREATE",
+    "ERR_QUERY_FAILED",
+    "ERR_ALREADY_IN_USE",
+    "ERR_LOCKED",
+    "ERR_TIMEOUT",
+    "ERR_CANT_CONNECT",
+    "ERR_CANT_RESOLVE",
+    "ERR_CONNECTION_ERROR",
+    "ERR_CANT_ACQUIRE_RESOURCE",
+    "ERR_CANT_FORK",
+    "ERR_INVALID_DATA",
+    "ERR_INVALID_PARAMETER",
+    "ERR_ALREADY_EXISTS",
+    "ERR_DOES_NOT_EXIST",
+    "ERR_DATABASE_CANT_READ",
+    "ERR_DATABASE_CANT_WRITE",
+    "ERR_COMPILATION_FAILED",
+    "ERR_METHOD_NOT_FOUND",
+    "ERR_LINK_FAILED",
+    "ERR_SCRIPT_FAILED",
+    "ERR_CYCLIC_LINK",
+    "ERR_INVALID_DECLARATION",
+    "ERR_DUPLICATE_SYMBOL",
+    "ERR_PARSE_ERROR",
+    "ERR_BUSY",
+    "ERR_SKIP",
+    "ERR_HELP",
+    "ERR_BUG",
+    "ERR_PRINTER_ON_FIRE"
+};
+
+}
+
+MTMidiFileStream::MTMidiFileStream(MTMidiFileStream &&other)
+{
+    *this = std::move(other);
+}
+
+/// @brief Takes over the file of another stream, closing the current file
+MTMidiFileStream &MTMidiFileStream::operator=(MTMidiFileStream &&other)
+{
+    if (this != &other)
+    {
+        close_file();
+        file = other.file;
+        size_bytes = other.size_bytes;
+        mode = other.mode;
+        buffer = other.buffer;
+        buffer_index = other.buffer_index;
+        buffer_count = other.buffer_count;
+        position = other.position;
+        other.file.unref();
+        other.buffer = PackedByteArray();
+        other.size_bytes = 0;
+        other.buffer_index = 0;
+        other.buffer_count = 0;
+        other.position = 0;
+    }
+    return *this;
+}
+
 MTMidiFileStream::~MTMidiFileStream()
 {
     close_file();
 }
 
+/// @brief Names an error for messages and logs
+/// @param error Error to name
+/// @return const char*, static text
+const char *MTMidiFileStream::get_error_text(Error error)
+{
+    if ((error >= 0) && (error < (int)(sizeof(ERROR_TEXTS) / sizeof(ERROR_TEXTS[0]))))
+    {
+        return ERROR_TEXTS[error];
+    }
+    return "Unknown error";
+}
+
 Error MTMidiFileStream::open_to_read(String file_path)
 {
     if (!file.is_null() && file->is_open())
@@ -22,6 +122,10 @@ Error MTMidiFileStream::open_to_read(String file_path)
         {
             mode = FileAccess::ModeFlags::READ;
             size_bytes = file->get_length();
+            buffer.clear();
+            buffer_index = 0;
+            buffer_count = 0;
+            position = 0;
             return Error::OK;
         }
 
@@ -47,23 +151,60 @@ Error MTMidiFileStream::open_to_write(String file_path, bool overwrite)
     {
         mode = FileAccess::ModeFlags::WRITE;
         size_bytes = 0;
+        buffer.resize(BUFFER_SIZE);
+        buffer_index = 0;
+        buffer_count = 0;
+        position = 0;
         return Error::OK;
     }
 
     return FileAccess::get_open_error();
 }
 
+/// @brief Closes the file, writing buffered data first
+/// Use flush() before to learn whether the data was written, a failure
+/// here is only logged.
+/// @return bool, false if no file was open
 bool MTMidiFileStream::close_file()
 {
     if (!file.is_null() && file->is_open())
     {
+        Error result = flush();
+        if (result != Error::OK)
+        {
+            WARN_PRINT_ED(vformat("Buffered data lost when closing file: %s", get_error_text(result)));
+        }
         file->close();
-        file->unreference();
+        file.unref();
+        buffer.clear();
+        buffer_index = 0;
+        buffer_count = 0;
         return true;
     }
     return false;
 }
 
+/// @brief Writes buffered data to the file
+/// @return Error, the error of the FileAccess if the data could not be written
+Error MTMidiFileStream::flush()
+{
+    if (!can_write() || (buffer_count == 0))
+    {
+        return Error::OK;
+    }
+
+    // Most flushes are of a full buffer, which is stored without a copy
+    bool stored = (buffer_count == BUFFER_SIZE) ?
+                  file->store_buffer(buffer) : file->store_buffer(buffer.slice(0, buffer_count));
+    buffer_count = 0;
+    if (!stored)
+    {
+        Error error = file->get_error();
+        return error != Error::OK ? error : Error::ERR_FILE_CANT_WRITE;
+    }
+    return Error::OK;
+}
+
 uint64_t MTMidiFileStream::get_length_bytes()
 {
     if (!file.is_null() && file->is_open())
@@ -77,7 +218,7 @@ uint64_t MTMidiFileStream::get_file_position()
 {
     if (!file.is_null() && file->is_open())
     {
-        return file->get_position();
+        return position;
     }
     return 0;
 }
@@ -86,7 +227,7 @@ uint64_t MTMidiFileStream::get_readable_byte_count()
 {
     if (!file.is_null() && file->is_open() && (mode == FileAccess::ModeFlags::READ))
     {
-        return size_bytes - file->get_position();
+        return size_bytes - position;
     }
     return 0;
 }
@@ -95,7 +236,7 @@ bool MTMidiFileStream::can_read(uint64_t count)
 {
     if (!file.is_null() && file->is_open() && (mode == FileAccess::ModeFlags::READ))
     {
-        return (size_bytes - file->get_position()) >= count;
+        return (size_bytes - position) >= count;
     }
     return false;
 }
@@ -109,107 +250,176 @@ bool MTMidiFileStream::can_write()
     return false;
 }
 
-Error MTMidiFileStream::read_bytes(uint64_t count, PackedByteArray buffer)
+/// @brief Reads data that is not all in the buffer, refilling it a block at a time
+/// @param data Pointer receiving 'count' bytes
+/// @param count uint64_t, number of bytes, checked with can_read()
+/// @return Error, ERR_FILE_CANT_READ if the file ends early
+Error MTMidiFileStream::read_buffered(uint8_t *data, uint64_t count)
 {
-    if (can_read(count))
+    while (count > 0)
     {
-        PackedByteArray buf = file->get_buffer(count);
-        if (buf.size() == count)
+        if (buffer_index == buffer_count)
         {
-            buffer.append_array(buf);
-            return Error::OK;
+            buffer = file->get_buffer(MIN(BUFFER_SIZE, size_bytes - file->get_position()));
+            buffer_index = 0;
+            buffer_count = buffer.size();
+            if (buffer_count == 0)
+            {
+                Error error = file->get_error();
+                return error != Error::OK ? error : Error::ERR_FILE_CANT_READ;
+            }
         }
-        return file->get_error();
+
+        uint64_t chunk = MIN(count, buffer_count - buffer_index);
+        memcpy(data, buffer.ptr() + buffer_index, chunk);
+        buffer_index += chunk;
+        position += chunk;
+        data += chunk;
+        count -= chunk;
     }
-    return Error::ERR_FILE_CANT_READ;
+    return Error::OK;
 }
 
-Error MTMidiFileStream::write_bytes(PackedByteArray buffer)
+/// @brief Writes data that does not fit the buffer, flushing it first
+/// Blocks of at least BUFFER_SIZE bytes are stored directly.
+/// @param data Pointer to the data
+/// @param count uint64_t, number of bytes, callers check can_write()
+/// @return Error, the error of the FileAccess if data could not be written
+Error MTMidiFileStream::write_buffered(const uint8_t *data, uint64_t count)
 {
-    if (can_write())
+    if (count >= BUFFER_SIZE)
     {
-        if (file->store_buffer(buffer))
+        PackedByteArray bytes;
+        bytes.resize(count);
+        memcpy(bytes.ptrw(), data, count);
+        return store_direct(bytes);
+    }
+
+    while (count > 0)
+    {
+        if (buffer_count == BUFFER_SIZE)
         {
-            size_bytes += buffer.size();
-            return Error::OK;
+            Error result = flush();
+            if (result != Error::OK)
+            {
+                return result;
+            }
         }
 
-        return file->get_error();
+        uint64_t chunk = MIN(count, BUFFER_SIZE - buffer_count);
+        memcpy(buffer.ptrw() + buffer_count, data, chunk);
+        buffer_count += chunk;
+        size_bytes += chunk;
+        position += chunk;
+        data += chunk;
+        count -= chunk;
     }
-    return Error::ERR_FILE_CANT_WRITE;
+    return Error::OK;
 }
 
-Error MTMidiFileStream::read_uint32(uint32_t& value_read)
+/// @brief Stores a large block as it is, after the buffered data
+/// @param bytes PackedByteArray, data to store, callers check can_write()
+/// @return Error, the error of the FileAccess if data could not be written
+Error MTMidiFileStream::store_direct(const PackedByteArray &bytes)
 {
-    PackedByteArray data;
-    Error result = read_bytes(4, data);
-    if (result == Error::OK)
+    Error result = flush();
+    if (result != Error::OK)
     {
-        value_read = (data[0] << 24) | 
-                     (data[1] << 16) | 
-                     (data[2] << 8) |
-                     data[3];
+        return result;
+    }
+    if (!file->store_buffer(bytes))
+    {
+        Error error = file->get_error();
+        return error != Error::OK ? error : Error::ERR_FILE_CANT_WRITE;
     }
-    return result;
+    size_bytes += bytes.size();
+    position += bytes.size();
+    return Error::OK;
 }
 
-Error MTMidiFileStream::write_uint32(uint32_t value)
+Error MTMidiFileStream::read_bytes(uint64_t count, PackedByteArray &bytes)
 {
-    if (can_write())
+    if (can_read(count))
     {
-        PackedByteArray data;
-
-        for (int i = 0; i < 4; ++i)
+        if (count == 0)
         {
-            data.append(value & 0xFF);
-            value = value >> 8;
+            return Error::OK;
         }
-
-        data.reverse();
-
-        if (file->store_buffer(data))
+        int64_t start = bytes.size();
+        bytes.resize(start + count);
+        Error result = read_raw(bytes.ptrw() + start, count);
+        if (result != Error::OK)
         {
-            size_bytes += 4;
-            return Error::OK;
+            bytes.resize(start);
         }
-
-        return file->get_error();
+        return result;
     }
-    return Error::ERR_FILE_CANT_WRITE;
+    return Error::ERR_FILE_CANT_READ;
 }
 
-Error MTMidiFileStream::read_uint16(uint16_t& value_read)
+Error MTMidiFileStream::write_bytes(const PackedByteArray &bytes)
 {
-    PackedByteArray data;
-    Error result = read_bytes(2, data);
-    if (result == Error::OK)
+    if (can_write())
     {
-        value_read = (data[0] << 8) | 
-                     data[1];
+        if (bytes.size() >= (int64_t)BUFFER_SIZE)
+        {
+            return store_direct(bytes);
+        }
+        return write_raw(bytes.ptr(), bytes.size());
     }
-    return result;
+    return Error::ERR_FILE_CANT_WRITE;
 }
 
-Error MTMidiFileStream::write_uint16(uint16_t value)
+Error MTMidiFileStream::read_uint32(uint32_t& value_read)
 {
-    if (can_write())
+    if (can_read(4))
     {
-        PackedByteArray data;
-        for (int i = 0; i < 2; ++i)
+        uint8_t data[4];
+        Error result = read_raw(data, 4);
+        if (result == Error::OK)
         {
-            data.append(value & 0xFF);
-            value = value >> 8;
+            value_read = (data[0] << 24) | 
+                         (data[1] << 16) | 
+                         (data[2] << 8) |
+                         data[3];
         }
+        return result;
+    }
+    return Error::ERR_FILE_CANT_READ;
+}
 
-        data.reverse();
+Error MTMidiFileStream::write_uint32(uint32_t value)
+{
+    if (can_write())
+    {
+        uint8_t data[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+        return write_raw(data, 4);
+    }
+    return Error::ERR_FILE_CANT_WRITE;
+}
 
-        if (file->store_buffer(data))
+Error MTMidiFileStream::read_uint16(uint16_t& value_read)
+{
+    if (can_read(2))
+    {
+        uint8_t data[2];
+        Error result = read_raw(data, 2);
+        if (result == Error::OK)
         {
-            size_bytes += 2;
-            return Error::OK;
+            value_read = (data[0] << 8) | 
+                         data[1];
         }
+        return result;
+    }
+    return Error::ERR_FILE_CANT_READ;
+}
 
-        return file->get_error();
+Error MTMidiFileStream::write_uint16(uint16_t value)
+{
+    if (can_write())
+    {
+        uint8_t data[2] = { (uint8_t)(value >> 8), (uint8_t)value };
+        return write_raw(data, 2);
     }
     return Error::ERR_FILE_CANT_WRITE;
 }
@@ -218,8 +428,7 @@ Error MTMidiFileStream::read_uint8(uint8_t& value_read)
 {
     if (can_read(1))
     {
-        value_read = file->get_8();
-        return Error::OK;
+        return read_raw(&value_read, 1);
     }
     return Error::ERR_FILE_CANT_READ;
 }
@@ -228,13 +437,7 @@ Error MTMidiFileStream::write_uint8(uint8_t value)
 {
     if (can_write())
     {
-        if (file->store_8(value))
-        {
-            size_bytes++;
-            return Error::OK;
-        }
-
-        return file->get_error();
+        return write_raw(&value, 1);
     }
     return Error::ERR_FILE_CANT_WRITE;
 }
@@ -242,18 +445,19 @@ Error MTMidiFileStream::write_uint8(uint8_t value)
 Error MTMidiFileStream::read_variable_length_value(uint32_t& value, uint32_t& read_count)
 {
     bool more_data = true;
-    PackedByteArray buffer;
     uint8_t data;
 
+    value = 0;
     read_count = 0;
 
-    while (more_data)
+    // Values are at most 4 bytes long
+    while (more_data && (read_count < 4))
     {
         Error result = read_uint8(data);
         if (result == Error::OK)
         {
             read_count++;
-            buffer.append(data & 0x7F);
+            value = (value << 7) | (data & 0x7F);
             more_data = data & 0x80;
         }
         else
@@ -262,34 +466,26 @@ Error MTMidiFileStream::read_variable_length_value(uint32_t& value, uint32_t& re
         }
     }
 
-    if ((read_count > 0) && (read_count <= 4))
-    {
-        value = variable_length_to_uint32(buffer);
-        return Error::OK;
-    }
-    
-    return Error::ERR_PARSE_ERROR;
+    return more_data ? Error::ERR_PARSE_ERROR : Error::OK;
 }
 
 Error MTMidiFileStream::write_variable_length_value(uint32_t value, uint32_t& write_count)
 {
-    if (can_write())
+    if (value > mtcore::MAX_VARIABLE_LENGTH)
     {
-        PackedByteArray buffer = uint32_to_variable_length(value);
-
-        if (file->store_buffer(buffer))
-        {
-            write_count = buffer.size();
-            size_bytes += write_count;
-            return Error::OK;
-        }
+        return Error::ERR_PARAMETER_RANGE_ERROR;
+    }
 
-        return file->get_error();
+    if (can_write())
+    {
+        uint8_t data[4];
+        write_count = mtcore::store_variable_length(value, data);
+        return write_raw(data, write_count);
     }
     return Error::ERR_FILE_CANT_WRITE;
 }
 
-uint32_t MTMidiFileStream::variable_length_to_uint32(PackedByteArray value)
+uint32_t MTMidiFileStream::variable_length_to_uint32(const PackedByteArray &value)
 {
     uint32_t return_value = 0;
     for (uint8_t cur_byte : value)
@@ -320,44 +516,26 @@ PackedByteArray MTMidiFileStream::uint32_to_variable_length(uint32_t value)
 
 uint32_t MTMidiFileStream::length_as_variable_length(uint32_t value)
 {
-    if (value < 128) return 1;
-    if (value < 16384) return 2;
-    if (value < 2097152) return 3;
-    if (value < 268435456) return 4;
-    return 5;
+    return mtcore::get_variable_length_size(value);
 }
 
-Error MTMidiFileStream::read_chunk_header(MIDIChunkHeader header)
+/// @brief Reads a chunk header, and the data of MThd chunks
+/// @param header MIDIChunkHeader receiving the type, length and MThd data
+/// @return Error, ERR_FILE_CANT_READ if less than 8 bytes are left
+Error MTMidiFileStream::read_chunk_header(MIDIChunkHeader &header)
 {
     if (can_read(8))
     {
-        PackedByteArray type_array;
-        uint32_t chunk_length = 0;
-        Error result = read_bytes(4, type_array);
+        uint8_t data[8];
+        Error result = read_raw(data, 8);
         if (result == Error::OK)
         {
-            result = read_uint32(chunk_length);
-        }
-        else
-        {
-            return result;
-        }
-
-        if (result == Error::OK)
-        {
-            header.chunk_length = chunk_length;
-            if (type_array == header.CHUNK_TYPE_FILE)
+            header.chunk_length = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+            header.chunk_type = MIDIChunkHeader::get_type(data);
+            if (header.chunk_type == MIDIChunkHeader::HeaderType::File)
             {
-                header.chunk_type = MIDIChunkHeader::HeaderType::File;
-                return read_bytes(chunk_length, header.header_data);
-            }
-            else if (type_array == header.CHUNK_TYPE_TRACK)
-            {
-                header.chunk_type = MIDIChunkHeader::HeaderType::Track;
-            }
-            else
-            {
-                header.chunk_type = MIDIChunkHeader::HeaderType::Unknown;
+                header.header_data.clear();
+                return read_bytes(header.chunk_length, header.header_data);
             }
         }
         return result;
@@ -365,7 +543,7 @@ Error MTMidiFileStream::read_chunk_header(MIDIChunkHeader header)
     return Error::ERR_FILE_CANT_READ;
 }
 
-Error MTMidiFileStream::write_chunk_header(MIDIChunkHeader header)
+Error MTMidiFileStream::write_chunk_header(const MIDIChunkHeader &header)
 {
     if (header.chunk_type == MIDIChunkHeader::HeaderType::Unknown)
     {
@@ -374,33 +552,19 @@ Error MTMidiFileStream::write_chunk_header(MIDIChunkHeader header)
 
     if (can_write())
     {
-        PackedByteArray buffer = (header.chunk_type == MIDIChunkHeader::HeaderType::File) ?
-                                 header.CHUNK_TYPE_FILE : header.CHUNK_TYPE_TRACK;
-
-        Error result = write_bytes(buffer);
-
-        if (result != Error::OK)
-        {
-            return result;
-        }
-
-        size_bytes += 4;
-        result = write_uint32(header.chunk_length);
-
-        if (result != Error::OK)
+        uint8_t data[8];
+        memcpy(data, (header.chunk_type == MIDIChunkHeader::HeaderType::File) ?
+               MIDIChunkHeader::CHUNK_TYPE_FILE : MIDIChunkHeader::CHUNK_TYPE_TRACK, 4);
+        for (int i = 0; i < 4; ++i)
         {
-            return result;
+            data[4 + i] = (header.chunk_length >> (24 - i * 8)) & 0xFF;
         }
 
-        size_bytes += 4;
+        Error result = write_raw(data, 8);
 
-        if (header.chunk_type == MIDIChunkHeader::HeaderType::File)
+        if ((result == Error::OK) && (header.chunk_type == MIDIChunkHeader::HeaderType::File))
         {
             result = write_bytes(header.header_data);
-            if (result == Error::OK)
-            {
-                size_bytes += header.header_data.size();
-            }
         }
 
         return result;
@@ -6,34 +6,25 @@
 #include <godot_cpp/classes/file_access.hpp>
 #include <godot_cpp/classes/ref.hpp>
 #include <godot_cpp/core/defs.hpp>
+#include <cstring>
 
 namespace godot {
 
-class MIDIChunkHeader : public Object {
+class MIDIChunkHeader {
     public:
         enum HeaderType { File, Track, Unknown };
-        const PackedByteArray CHUNK_TYPE_FILE = {'M','T','h','d'};
-        const PackedByteArray CHUNK_TYPE_TRACK = {'M','T','r','k'};
+        static constexpr uint8_t CHUNK_TYPE_FILE[4] = {'M','T','h','d'};
+        static constexpr uint8_t CHUNK_TYPE_TRACK[4] = {'M','T','r','k'};
 
         HeaderType chunk_type;
         uint32_t chunk_length;
         PackedByteArray header_data;
 
-    MIDIChunkHeader(PackedByteArray ctype, uint32_t clength)
+    // ctype points to the 4 type bytes of a chunk
+    MIDIChunkHeader(const uint8_t *ctype, uint32_t clength)
     {
-        chunk_type = HeaderType::Unknown;
         chunk_length = clength;
-        if (ctype.size() == 4)
-        {
-            if (ctype == CHUNK_TYPE_FILE)
-            {
-                chunk_type = HeaderType::File;
-            }
-            else if (ctype == CHUNK_TYPE_TRACK)
-            {
-                chunk_type = HeaderType::Track;
-            }
-        }
+        chunk_type = get_type(ctype);
     }
 
     MIDIChunkHeader(HeaderType ctype, uint32_t clength)
@@ -46,7 +37,20 @@ class MIDIChunkHeader : public Object {
         }
     }
 
-    uint16_t get_format()
+    static HeaderType get_type(const uint8_t *ctype)
+    {
+        if (memcmp(ctype, CHUNK_TYPE_FILE, 4) == 0)
+        {
+            return HeaderType::File;
+        }
+        if (memcmp(ctype, CHUNK_TYPE_TRACK, 4) == 0)
+        {
+            return HeaderType::Track;
+        }
+        return HeaderType::Unknown;
+    }
+
+    uint16_t get_format() const
     {
         if ((chunk_type == HeaderType::File) && (header_data.size() > 1))
         {
@@ -66,7 +70,7 @@ class MIDIChunkHeader : public Object {
         return false;
     }
 
-    uint16_t get_track_count()
+    uint16_t get_track_count() const
     {
         if ((chunk_type == HeaderType::File) && (header_data.size() > 3))
         {
@@ -86,7 +90,7 @@ class MIDIChunkHeader : public Object {
         return false;
     }
 
-    uint16_t get_division()
+    uint16_t get_division() const
     {
         if ((chunk_type == HeaderType::File) && (header_data.size() > 5))
         {
@@ -107,78 +111,72 @@ class MIDIChunkHeader : public Object {
     }
 };
 
-class MTMidiFileStream : public Object {
+// Reads or writes one file.  Streams can be moved but not copied, a copy
+// would close the file of the original when destroyed.
+// Data goes through a buffer, so the FileAccess is only used for blocks of
+// BUFFER_SIZE bytes.  Writes reach the file on flush() or close_file().
+class MTMidiFileStream {
     private:
+        static const uint64_t BUFFER_SIZE = 64 * 1024;
+
         Ref<FileAccess> file;
-        uint64_t size_bytes;
-        FileAccess::ModeFlags mode;
+        uint64_t size_bytes = 0;
+        FileAccess::ModeFlags mode = FileAccess::ModeFlags::READ;
+        PackedByteArray buffer;         // Data read ahead, or not written yet
+        uint64_t buffer_index = 0;      // Next byte to read from the buffer
+        uint64_t buffer_count = 0;      // Bytes held in the buffer
+        uint64_t position = 0;          // Position in the file, as seen by the caller
+
+        Error read_buffered(uint8_t *data, uint64_t count);
+        Error write_buffered(const uint8_t *data, uint64_t count);
+        Error store_direct(const PackedByteArray &bytes);
+
+        // Callers check can_read() or can_write() first
+        Error read_raw(uint8_t *data, uint64_t count)
+        {
+            if (count <= buffer_count - buffer_index)
+            {
+                memcpy(data, buffer.ptr() + buffer_index, count);
+                buffer_index += count;
+                position += count;
+                return Error::OK;
+            }
+            return read_buffered(data, count);
+        }
+
+        Error write_raw(const uint8_t *data, uint64_t count)
+        {
+            if (count <= BUFFER_SIZE - buffer_count)
+            {
+                memcpy(buffer.ptrw() + buffer_count, data, count);
+                buffer_count += count;
+                size_bytes += count;
+                position += count;
+                return Error::OK;
+            }
+            return write_buffered(data, count);
+        }
     
     public:
-        const PackedStringArray ErrorMsgs = {
-            "OK",
-            "FAILED",
-            "ERR_UNAVAILABLE",
-            "ERR_UNCONFIGURED",
-            "ERR_UNAUTHORIZED",
-            "ERR_PARAMETER_RANGE_ERROR",
-            "ERR_OUT_OF_MEMORY",
-            "ERR_FILE_NOT_FOUND",
-            "ERR_FILE_BAD_DRIVE",
-            "ERR_FILE_BAD_PATH",
-            "ERR_FILE_NO_PERMISSION",
-            "ERR_FILE_ALREADY_IN_USE",
-            "ERR_FILE_CANT_OPEN",
-            "ERR_FILE_CANT_WRITE",
-            "ERR_FILE_CANT_READ",
-            "ERR_FILE_UNRECOGNIZED",
-            "ERR_FILE_CORRUPT",
-            "ERR_FILE_MISSING_DEPENDENCIES",
-            "ERR_FILE_EOF",
-            "ERR_CANT_OPEN",
-            "ERR_CANT_CREATE",
-            "ERR_QUERY_FAILED",
-            "ERR_ALREADY_IN_USE",
-            "ERR_LOCKED",
-            "ERR_TIMEOUT",
-            "ERR_CANT_CONNECT",
-            "ERR_CANT_RESOLVE",
-            "ERR_CONNECTION_ERROR",
-            "ERR_CANT_ACQUIRE_RESOURCE",
-            "ERR_CANT_FORK",
-            "ERR_INVALID_DATA",
-            "ERR_INVALID_PARAMETER",
-            "ERR_ALREADY_EXISTS",
-            "ERR_DOES_NOT_EXIST",
-            "ERR_DATABASE_CANT_READ",
-            "ERR_DATABASE_CANT_WRITE",
-            "ERR_COMPILATION_FAILED",
-            "ERR_METHOD_NOT_FOUND",
-            "ERR_LINK_FAILED",
-            "ERR_SCRIPT_FAILED",
-            "ERR_CYCLIC_LINK",
-            "ERR_INVALID_DECLARATION",
-            "ERR_DUPLICATE_SYMBOL",
-            "ERR_PARSE_ERROR",
-            "ERR_BUSY",
-            "ERR_SKIP",
-            "ERR_HELP",
-            "ERR_BUG",
-            "ERR_PRINTER_ON_FIRE"
-        };
 
         MTMidiFileStream(){};
+        MTMidiFileStream(MTMidiFileStream &&other);
+        MTMidiFileStream &operator=(MTMidiFileStream &&other);
+        MTMidiFileStream(const MTMidiFileStream &) = delete;
+        MTMidiFileStream &operator=(const MTMidiFileStream &) = delete;
         ~MTMidiFileStream();
 
         Error open_to_read(String file_path);
         Error open_to_write(String file_path, bool overwrite = false);
         bool close_file();
+        Error flush();
         uint64_t get_length_bytes();
         uint64_t get_file_position();
         uint64_t get_readable_byte_count();
         bool can_read(uint64_t count);
         bool can_write();
-        Error read_bytes(uint64_t count, PackedByteArray buffer);
-        Error write_bytes(PackedByteArray buffer);
+        Error read_bytes(uint64_t count, PackedByteArray &bytes);
+        Error write_bytes(const PackedByteArray &bytes);
         Error read_uint32(uint32_t& value_read);
         Error write_uint32(uint32_t value);
         Error read_uint16(uint16_t& value_read);
@@ -187,11 +185,12 @@ class MTMidiFileStream : public Object {
         Error write_uint8(uint8_t value);
         Error read_variable_length_value(uint32_t& value, uint32_t& read_count);
         Error write_variable_length_value(uint32_t value, uint32_t& write_count);
-        static uint32_t variable_length_to_uint32(PackedByteArray value);
+        static const char *get_error_text(Error error);
+        static uint32_t variable_length_to_uint32(const PackedByteArray &value);
         static PackedByteArray uint32_to_variable_length(uint32_t value);
         static uint32_t length_as_variable_length(uint32_t value);
-        Error read_chunk_header(MIDIChunkHeader header);
-        Error write_chunk_header(MIDIChunkHeader header);
+        Error read_chunk_header(MIDIChunkHeader &header);
+        Error write_chunk_header(const MIDIChunkHeader &header);
 };
 }
 #endif
@@ -0,0 +1,121 @@
+#include "mt_midi_import_plugin.hpp"
+#include "mt_midi_cache.hpp"
+#include "mt_midi_stream_parser.hpp"
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+using namespace godot;
+
+/// @brief Parses a standard MIDI file into an empty MTMidiFile
+/// The whole file is read at once and decoded with MTMidiStreamParser.
+/// @param path String, path of the MIDI file
+/// @param file Ref to the MTMidiFile receiving the tracks
+/// @return Error, OK on success
+Error MTMidiFileFormatLoader::parse_midi_file(const String &path, const Ref<MTMidiFile> &file)
+{
+    if (!FileAccess::file_exists(path))
+    {
+        return Error::ERR_FILE_NOT_FOUND;
+    }
+
+    PackedByteArray bytes = FileAccess::get_file_as_bytes(path);
+    Ref<MTMidiStreamParser> parser;
+    parser.instantiate();
+    Error result = Error::OK;
+
+    if (!parser->begin(file) || (parser->feed(bytes) < 0) || !parser->finish())
+    {
+        result = parser->get_last_error() != Error::OK ? parser->get_last_error() : Error::ERR_PARSE_ERROR;
+    }
+
+    if (result == Error::OK)
+    {
+        file->update_file_name(path);
+    }
+    return result;
+}
+
+PackedStringArray MTMidiFileFormatLoader::_get_recognized_extensions() const
+{
+    PackedStringArray extensions;
+    extensions.append("mid");
+    extensions.append("midi");
+    return extensions;
+}
+
+bool MTMidiFileFormatLoader::_handles_type(const StringName &type) const
+{
+    return (type == StringName("MTMidiFile")) || (type == StringName("Resource"));
+}
+
+String MTMidiFileFormatLoader::_get_resource_type(const String &path) const
+{
+    String extension = path.get_extension().to_lower();
+    if ((extension == "mid") || (extension == "midi"))
+    {
+        return "MTMidiFile";
+    }
+    return "";
+}
+
+Variant MTMidiFileFormatLoader::_load(const String &path, const String &original_path,
+                                      bool use_sub_threads, int32_t cache_mode) const
+{
+    Ref<MTMidiFile> file;
+    file.instantiate();
+    Error result = parse_midi_file(path, file);
+    if (result != Error::OK)
+    {
+        WARN_PRINT_ED(vformat("Could not load MIDI file: %s : Error %d", path, result));
+        return (int64_t)result;
+    }
+    return file;
+}
+
+PackedStringArray MTMidiImportPlugin::_get_recognized_extensions() const
+{
+    PackedStringArray extensions;
+    extensions.append("mid");
+    extensions.append("midi");
+    return extensions;
+}
+
+String MTMidiImportPlugin::_get_save_extension() const
+{
+    return MTMidiCache::get_extension();
+}
+
+TypedArray<Dictionary> MTMidiImportPlugin::_get_import_options(const String &path, int32_t preset_index) const
+{
+    return TypedArray<Dictionary>();
+}
+
+/// @brief Converts a MIDI file to the MIDI cache format
+/// The imported file is loaded by MTMidiCacheFormatLoader, so the resource
+/// is shared through the resource cache and can be loaded in the background.
+Error MTMidiImportPlugin::_import(const String &source_file, const String &save_path, const Dictionary &options,
+                                  const TypedArray<String> &platform_variants, const TypedArray<String> &gen_files) const
+{
+    Ref<MTMidiFile> file;
+    file.instantiate();
+    Error result = MTMidiFileFormatLoader::parse_midi_file(source_file, file);
+    if (result != Error::OK)
+    {
+        WARN_PRINT_ED(vformat("Could not import MIDI file: %s : Error %d", source_file, result));
+        return result;
+    }
+
+    return MTMidiCache::write(file.ptr(), save_path + "." + _get_save_extension());
+}
+
+void MTMidiEditorPlugin::_enter_tree()
+{
+    import_plugin.instantiate();
+    add_import_plugin(import_plugin);
+}
+
+void MTMidiEditorPlugin::_exit_tree()
+{
+    remove_import_plugin(import_plugin);
+    import_plugin.unref();
+}
@@ -0,0 +1,67 @@
+#ifndef MT_MIDI_IMPORT_PLUGIN_H
+#define MT_MIDI_IMPORT_PLUGIN_H
+
+#include <godot_cpp/classes/editor_import_plugin.hpp>
+#include <godot_cpp/classes/editor_plugin.hpp>
+#include <godot_cpp/classes/resource_format_loader.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/typed_array.hpp>
+#include "mt_midi_file.hpp"
+
+namespace godot {
+
+// Loads .mid files which were not imported, e.g. from user://
+class MTMidiFileFormatLoader : public ResourceFormatLoader {
+    GDCLASS(MTMidiFileFormatLoader, ResourceFormatLoader)
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    static Error parse_midi_file(const String &path, const Ref<MTMidiFile> &file);
+
+    PackedStringArray _get_recognized_extensions() const override;
+    bool _handles_type(const StringName &type) const override;
+    String _get_resource_type(const String &path) const override;
+    Variant _load(const String &path, const String &original_path, bool use_sub_threads, int32_t cache_mode) const override;
+};
+
+// Imports .mid files as MTMidiFile resources, stored in the MIDI cache format
+class MTMidiImportPlugin : public EditorImportPlugin {
+    GDCLASS(MTMidiImportPlugin, EditorImportPlugin)
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    String _get_importer_name() const override { return "miditools.midi"; }
+    String _get_visible_name() const override { return "MIDI File"; }
+    PackedStringArray _get_recognized_extensions() const override;
+    String _get_save_extension() const override;
+    String _get_resource_type() const override { return "MTMidiFile"; }
+    int32_t _get_preset_count() const override { return 1; }
+    String _get_preset_name(int32_t preset_index) const override { return "Default"; }
+    TypedArray<Dictionary> _get_import_options(const String &path, int32_t preset_index) const override;
+    bool _get_option_visibility(const String &path, const StringName &option_name, const Dictionary &options) const override { return true; }
+    double _get_priority() const override { return 1.0; }
+    int32_t _get_import_order() const override { return 0; }
+    Error _import(const String &source_file, const String &save_path, const Dictionary &options,
+                  const TypedArray<String> &platform_variants, const TypedArray<String> &gen_files) const override;
+};
+
+class MTMidiEditorPlugin : public EditorPlugin {
+    GDCLASS(MTMidiEditorPlugin, EditorPlugin)
+
+    Ref<MTMidiImportPlugin> import_plugin;
+
+protected:
+    static void _bind_methods() {}
+
+public:
+    void _enter_tree() override;
+    void _exit_tree() override;
+};
+
+}
+#endif
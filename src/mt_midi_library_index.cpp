@@ -0,0 +1,298 @@
+#include "mt_midi_library_index.hpp"
+#include "mt_midi_file.hpp"
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/templates/hash_set.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+
+using namespace godot;
+
+void MTMidiLibraryIndex::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("index_directory", "dir_path", "recursive"), &MTMidiLibraryIndex::index_directory, DEFVAL(true));
+	ClassDB::bind_method(D_METHOD("clear"), &MTMidiLibraryIndex::clear);
+	ClassDB::bind_method(D_METHOD("get_file_count"), &MTMidiLibraryIndex::get_file_count);
+	ClassDB::bind_method(D_METHOD("get_files"), &MTMidiLibraryIndex::get_files);
+	ClassDB::bind_method(D_METHOD("get_summary", "file_path"), &MTMidiLibraryIndex::get_summary);
+	ClassDB::bind_method(D_METHOD("find_by_name", "text"), &MTMidiLibraryIndex::find_by_name);
+	ClassDB::bind_method(D_METHOD("find_by_duration", "min_seconds", "max_seconds"), &MTMidiLibraryIndex::find_by_duration);
+	ClassDB::bind_method(D_METHOD("find_by_program", "program"), &MTMidiLibraryIndex::find_by_program);
+	ClassDB::bind_method(D_METHOD("find_by_key", "sharps", "minor"), &MTMidiLibraryIndex::find_by_key);
+}
+
+MTMidiLibraryIndex::MTMidiLibraryIndex()
+{
+    mutex.instantiate();
+}
+
+/// @brief Indexes all MIDI files in a directory
+/// New files and files modified since they were last indexed are scanned
+/// in parallel on the WorkerThreadPool, files which no longer exist are
+/// removed.  Blocks until all files are scanned, call it from a Thread to
+/// keep the main loop running; the index can be searched meanwhile.
+/// @param dir_path String, directory to index
+/// @param recursive bool, also index subdirectories
+/// @return int64_t, number of files scanned, -1 on error
+int64_t MTMidiLibraryIndex::index_directory(String dir_path, bool recursive)
+{
+    if (!DirAccess::dir_exists_absolute(dir_path))
+    {
+        WARN_PRINT_ED(vformat("MTMidiLibraryIndex: Directory not found: %s", dir_path));
+        return -1;
+    }
+
+    mutex->lock();
+    if (indexing)
+    {
+        mutex->unlock();
+        WARN_PRINT_ED("MTMidiLibraryIndex: Already indexing a directory");
+        return -1;
+    }
+    indexing = true;
+    mutex->unlock();
+
+    // The directory walk and the stats are slow, searches may run meanwhile
+    PackedStringArray files;
+    collect_files(dir_path, recursive, files);
+    Vector<uint64_t> modified_times;
+    modified_times.resize(files.size());
+    HashSet<String> found;
+    for (int64_t index = 0; index < files.size(); ++index)
+    {
+        modified_times.set(index, FileAccess::get_modified_time(files[index]));
+        found.insert(files[index]);
+    }
+
+    mutex->lock();
+    pending.clear();
+    for (int64_t index = 0; index < files.size(); ++index)
+    {
+        HashMap<String, Entry>::Iterator element = entries.find(files[index]);
+        if ((element == entries.end()) || (element->value.modified_time != modified_times[index]))
+        {
+            Entry entry;
+            entry.path = files[index];
+            entry.modified_time = modified_times[index];
+            pending.push_back(entry);
+        }
+    }
+
+    // Forget deleted files, subdirectories only when they were walked
+    String prefix = dir_path.ends_with("/") ? dir_path : dir_path + "/";
+    Vector<String> removed;
+    for (const KeyValue<String, Entry> &element : entries)
+    {
+        if (element.key.begins_with(prefix) && !found.has(element.key) &&
+            (recursive || (element.key.find("/", prefix.length()) == -1)))
+        {
+            removed.push_back(element.key);
+        }
+    }
+    for (const String &file_path : removed)
+    {
+        entries.erase(file_path);
+    }
+
+    pending_ptr = pending.ptrw();
+    mutex->unlock();
+
+    if (!pending.is_empty())
+    {
+        WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+        int64_t task_id = pool->add_group_task(callable_mp(this, &MTMidiLibraryIndex::scan_task),
+                                               pending.size(), -1, false, "MTMidiLibraryIndex");
+        pool->wait_for_group_task_completion(task_id);
+    }
+
+    mutex->lock();
+    for (const Entry &entry : pending)
+    {
+        entries.insert(entry.path, entry);
+    }
+    int64_t scanned = pending.size();
+    pending.clear();
+    pending_ptr = nullptr;
+    indexing = false;
+    mutex->unlock();
+
+    return scanned;
+}
+
+void MTMidiLibraryIndex::collect_files(const String &dir_path, bool recursive, PackedStringArray &files)
+{
+    String base = dir_path.ends_with("/") ? dir_path : dir_path + "/";
+    for (const String &file_name : DirAccess::get_files_at(dir_path))
+    {
+        String extension = file_name.get_extension().to_lower();
+        if ((extension == "mid") || (extension == "midi"))
+        {
+            files.append(base + file_name);
+        }
+    }
+
+    if (recursive)
+    {
+        for (const String &sub_dir : DirAccess::get_directories_at(dir_path))
+        {
+            collect_files(base + sub_dir, recursive, files);
+        }
+    }
+}
+
+/// @brief Scans one pending file, runs on the WorkerThreadPool
+/// Each task only writes its own pending entry, so no locking is needed.
+void MTMidiLibraryIndex::scan_task(uint32_t index)
+{
+    Entry &entry = pending_ptr[index];
+    entry.summary = MTMidiFile::scan_file(entry.path);
+    entry.valid = (int64_t)entry.summary["error"] == Error::OK;
+
+    PackedStringArray track_names = entry.summary["track_names"];
+    entry.search_text = (entry.path.get_file() + "\n" + String("\n").join(track_names)).to_lower();
+    entry.duration = entry.summary["duration"];
+
+    PackedInt32Array programs = entry.summary["programs"];
+    for (int32_t program : programs)
+    {
+        entry.programs[(program >> 6) & 1] |= 1ULL << (program & 0x3F);
+    }
+
+    PackedInt32Array key_signature = entry.summary["key_signature"];
+    if (key_signature.size() == 2)
+    {
+        entry.key_sharps = key_signature[0];
+        entry.key_minor = key_signature[1];
+    }
+}
+
+void MTMidiLibraryIndex::clear()
+{
+    mutex->lock();
+    entries.clear();
+    mutex->unlock();
+}
+
+int64_t MTMidiLibraryIndex::get_file_count()
+{
+    mutex->lock();
+    int64_t count = entries.size();
+    mutex->unlock();
+    return count;
+}
+
+/// @brief Returns the paths of all indexed files, sorted
+PackedStringArray MTMidiLibraryIndex::get_files()
+{
+    PackedStringArray files;
+    mutex->lock();
+    for (const KeyValue<String, Entry> &element : entries)
+    {
+        files.append(element.key);
+    }
+    mutex->unlock();
+    files.sort();
+    return files;
+}
+
+/// @brief Returns the MTMidiFile.scan_file summary of an indexed file
+/// @param file_path String, path of the file
+/// @return Dictionary, empty if the file is not indexed
+Dictionary MTMidiLibraryIndex::get_summary(String file_path)
+{
+    Dictionary summary;
+    mutex->lock();
+    HashMap<String, Entry>::Iterator element = entries.find(file_path);
+    if (element != entries.end())
+    {
+        summary = element->value.summary.duplicate();
+    }
+    mutex->unlock();
+    return summary;
+}
+
+/// @brief Finds files whose file name or track names contain a text
+/// @param text String, text to find, not case sensitive
+/// @return PackedStringArray, sorted paths of the matching files
+PackedStringArray MTMidiLibraryIndex::find_by_name(String text)
+{
+    String lower_text = text.to_lower();
+    PackedStringArray files;
+    mutex->lock();
+    for (const KeyValue<String, Entry> &element : entries)
+    {
+        if (element.value.search_text.contains(lower_text))
+        {
+            files.append(element.key);
+        }
+    }
+    mutex->unlock();
+    files.sort();
+    return files;
+}
+
+/// @brief Finds files with a duration within a range
+/// @param min_seconds double, minimum duration
+/// @param max_seconds double, maximum duration
+/// @return PackedStringArray, sorted paths of the matching files
+PackedStringArray MTMidiLibraryIndex::find_by_duration(double min_seconds, double max_seconds)
+{
+    PackedStringArray files;
+    mutex->lock();
+    for (const KeyValue<String, Entry> &element : entries)
+    {
+        const Entry &entry = element.value;
+        if (entry.valid && (entry.duration >= min_seconds) && (entry.duration <= max_seconds))
+        {
+            files.append(element.key);
+        }
+    }
+    mutex->unlock();
+    files.sort();
+    return files;
+}
+
+/// @brief Finds files using a General MIDI program on a non-drum channel
+/// @param program int, program number 0-127
+/// @return PackedStringArray, sorted paths of the matching files
+PackedStringArray MTMidiLibraryIndex::find_by_program(int program)
+{
+    PackedStringArray files;
+    if ((program < 0) || (program > 127))
+    {
+        return files;
+    }
+
+    mutex->lock();
+    for (const KeyValue<String, Entry> &element : entries)
+    {
+        if ((element.value.programs[program >> 6] >> (program & 0x3F)) & 1)
+        {
+            files.append(element.key);
+        }
+    }
+    mutex->unlock();
+    files.sort();
+    return files;
+}
+
+/// @brief Finds files starting in a key
+/// @param sharps int, number of sharps, negative for flats
+/// @param minor bool, minor key
+/// @return PackedStringArray, sorted paths of the matching files
+PackedStringArray MTMidiLibraryIndex::find_by_key(int sharps, bool minor)
+{
+    PackedStringArray files;
+    mutex->lock();
+    for (const KeyValue<String, Entry> &element : entries)
+    {
+        const Entry &entry = element.value;
+        if ((entry.key_minor == (minor ? 1 : 0)) && (entry.key_sharps == sharps))
+        {
+            files.append(element.key);
+        }
+    }
+    mutex->unlock();
+    files.sort();
+    return files;
+}
@@ -0,0 +1,60 @@
+#ifndef MT_MIDI_LIBRARY_INDEX_H
+#define MT_MIDI_LIBRARY_INDEX_H
+
+#include <godot_cpp/classes/mutex.hpp>
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/vector.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+
+namespace godot {
+
+// Searchable index of the MIDI files in one or more directories.
+// Files are summarized with MTMidiFile::scan_file on the WorkerThreadPool,
+// and only files whose modification time changed are scanned again.
+class MTMidiLibraryIndex : public Node {
+    GDCLASS(MTMidiLibraryIndex, Node)
+
+    struct Entry {
+        String path;
+        uint64_t modified_time = 0;
+        Dictionary summary;
+        String search_text;
+        double duration = 0.0;
+        uint64_t programs[2] = { 0, 0 };
+        int32_t key_sharps = 0;
+        int32_t key_minor = -1;     // -1 without key signature
+        bool valid = false;
+    };
+
+    HashMap<String, Entry> entries;
+    Ref<Mutex> mutex;
+
+    // Files being scanned by the current index_directory() call
+    Vector<Entry> pending;
+    Entry *pending_ptr = nullptr;
+    bool indexing = false;
+
+    void collect_files(const String &dir_path, bool recursive, PackedStringArray &files);
+    void scan_task(uint32_t index);
+
+protected:
+    static void _bind_methods();
+
+public:
+    MTMidiLibraryIndex();
+
+    int64_t index_directory(String dir_path, bool recursive = true);
+    void clear();
+    int64_t get_file_count();
+    PackedStringArray get_files();
+    Dictionary get_summary(String file_path);
+    PackedStringArray find_by_name(String text);
+    PackedStringArray find_by_duration(double min_seconds, double max_seconds);
+    PackedStringArray find_by_program(int program);
+    PackedStringArray find_by_key(int sharps, bool minor);
+};
+
+}
+#endif
@@ -3,8 +3,8 @@
 
 using namespace godot;
 
-// Initialize MTMidiMsg static message id sequence
-uint64_t MTMidiMsg::next_msg_id = 0;
+// MTMidiMsg message id sequence, shared by all threads
+SafeNumeric<uint64_t> MTMidiMsg::next_msg_id;
 
 void MTMidiMsg::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_id"), &MTMidiMsg::get_id);
@@ -26,14 +26,12 @@ void MTMidiMsg::_bind_methods() {
 
 MTMidiMsg::MTMidiMsg()
 {
-    id = next_msg_id++;
     tick = 0;
 }
 
 MTMidiMsg::MTMidiMsg(uint64_t tick, uint8_t status_byte, int32_t data_length) :
     tick(tick)
 {
-    id = next_msg_id++;
     msg_bytes.resize(data_length + 1);
     msg_bytes.set(0, status_byte);
 }
@@ -41,10 +39,22 @@ MTMidiMsg::MTMidiMsg(uint64_t tick, uint8_t status_byte, int32_t data_length) :
 MTMidiMsg::MTMidiMsg(uint64_t tick, PackedByteArray msg_as_bytes) :
     tick(tick)
 {
-    id = next_msg_id++;
     msg_bytes.append_array(msg_as_bytes);
 }
 
+/// @brief Returns the id of the message
+/// Messages are numbered on first use, so creating a message never touches
+/// the shared counter and messages can be created on any thread.
+/// @return uint64_t, id of the message, unique while the message exists
+uint64_t MTMidiMsg::get_id()
+{
+    if (id == 0)
+    {
+        id = next_msg_id.increment();
+    }
+    return id;
+}
+
 int32_t MTMidiMsg::get_status_byte()
 {
     if (msg_bytes.size() > 0)
@@ -143,252 +153,74 @@ String MTMidiMsg::get_meta_msg_text()
     return buffer.get_string_from_utf8();
 }
 
-MTMidiMsg *MTMidiMsg::read_msg(
-    uint64_t tick,
-    uint8_t& running_status,
-    uint8_t& channel_prefix,
-    uint8_t& port_prefix,
-    MTDataBuffer &buffer,
-    int32_t& bytes_read)
-{
-    bytes_read = 0;
-
-    uint8_t status_byte = running_status;
-    if ((buffer.unread_count() > 0) && (is_status_byte(buffer.peek())))
-    {
-        buffer.read_byte(status_byte);
-        ++bytes_read;
-    }
-
-    int32_t read_count;
-    switch (status_byte & 0xF0)
-    {
-        case ChannelMsgType::NoteOff:
-        case ChannelMsgType::NoteOn:
-        case ChannelMsgType::PolyKeyPressure:
-        case ChannelMsgType::ControlChange:
-        case ChannelMsgType::ProgramChange:
-        case ChannelMsgType::ChannelPressure:
-        case ChannelMsgType::PitchBend:
-            {
-                // Store running status
-                running_status = status_byte;
-                MTMidiMsg* msg = read_channel_msg(tick, status_byte, buffer, read_count);
-                bytes_read = read_count > -1 ? bytes_read + read_count : read_count;
-                if (msg != nullptr)
-                {
-                    channel_prefix = msg->get_channel();
-                    msg->port_prefix = port_prefix;
-                }
-                return msg;
-            }
-            break;
-        case ChannelMsgType::NonChannel:
-            switch (status_byte)
-            {
-                case NonChMsgType::SysexStart: // Sysex Msg Start event
-                case NonChMsgType::SysexContOrEsc: // Sysex Msg Continue or Escape event
-                    {
-                        MTMidiMsg* msg = read_sysex_msg(tick, status_byte, buffer, read_count);
-                        if (msg != nullptr)
-                        {
-                            msg->port_prefix = port_prefix;
-                        }
-                        bytes_read = read_count > -1 ? bytes_read + read_count : read_count;
-                        return msg;
-                    }
-                    break;
-                case NonChMsgType::Meta: // Meta event
-                    {
-                        MTMidiMsg* msg = read_meta_msg(tick, status_byte, buffer, read_count);
-                        bytes_read = read_count > -1 ? bytes_read + read_count : read_count;
-                        if (msg != nullptr)
-                        {
-                            if (msg->get_meta_msg_type() == MetaMsgType::ChannelPrefix)
-                            {
-                                channel_prefix = msg->read_data_value(0);
-                            }
-
-                            if (msg->get_meta_msg_type() == MetaMsgType::PortPrefix)
-                            {
-                                port_prefix = msg->read_data_value(0);
-                            }
-
-                            msg->channel_prefix = channel_prefix;
-                            msg->port_prefix = port_prefix;
-                        }
-                        return msg;
-                    }
-                    break;
-                default: // Unknown event
-                    WARN_PRINT_ED(vformat("Unrecognized event type: %d", status_byte));
-                    break;
-            }
-            break;
-    }
-    return nullptr;
-}
-
-MTMidiMsg *MTMidiMsg::read_channel_msg(
-    uint64_t ticks,
-    uint8_t status_byte,
-    MTDataBuffer &buffer,
-    int32_t& bytes_read)
+/// @brief Decodes the message at 'data' into an event, without creating an MTMidiMsg
+/// Follows the same rules as peek_msg_length().  The message bytes, including the
+/// status byte when running status is used, are copied into the arena.
+/// The caller sets the tick of the event.
+/// @param data Pointer to the status byte, or the first data byte when
+///             running status is in effect
+/// @param available uint64_t, number of bytes available at 'data'
+/// @param running_status uint8_t, status byte of the previous channel message, updated
+/// @param channel_prefix uint8_t, current MIDI channel prefix, updated
+/// @param port_prefix uint8_t, current MIDI port prefix, updated
+/// @param arena MTMidiArena receiving the message bytes
+/// @param event MTMidiEvent receiving the message
+/// @return int32_t, number of bytes consumed from 'data', 0 if more data is
+///         needed, -1 if the message can not be decoded
+int32_t MTMidiMsg::decode_event(
+    const uint8_t *data,
+    uint64_t available,
+    uint8_t &running_status,
+    uint8_t &channel_prefix,
+    uint8_t &port_prefix,
+    MTMidiArena &arena,
+    MTMidiEvent &event)
 {
-    bytes_read = 0;
-
-    uint8_t db1 = 0;
-    uint8_t db2 = UINT8_MAX;
-    switch (status_byte & 0xF0)
-    {
-        case ChannelMsgType::NonChannel:
-            WARN_PRINT_ED("Found unrecognized message in ReadChannelMsg");
-            bytes_read = -1;
-            break;
-        case ChannelMsgType::NoteOff:
-        case ChannelMsgType::NoteOn:
-            if ((buffer.read_byte(db1) == Error::OK) && (buffer.read_byte(db2) == Error::OK))
-            {
-                db1 &= 0x7F;
-                db2 &= 0x7F;
-                bytes_read = 2;
-            }
-            else
-            {
-                WARN_PRINT_ED("Not enough data available to read Note msg");
-                bytes_read = -1;
-            }
-            break;
-        case ChannelMsgType::ProgramChange:
-        case ChannelMsgType::ChannelPressure:
-            if (buffer.read_byte(db1) == Error::OK)
-            {
-                bytes_read = 1;
-            }
-            else
-            {
-                WARN_PRINT_ED("Not enough data to read single-byte MTMidiMsg");
-                bytes_read = -1;
-            }
-            break;
-        default:
-            if ((buffer.read_byte(db1) == Error::OK) && (buffer.read_byte(db2) == Error::OK))
-            {
-                bytes_read = 2;
-            }
-            else
-            {
-                WARN_PRINT_ED("Not enough data to read double-byte MTMidiMsg");
-                bytes_read = -1;
-            }
-            break;
-    }
-
-    if (bytes_read > 0)
+    int32_t length = peek_msg_length(data, available, running_status);
+    if (length > 0)
     {
-        MTMidiMsg *new_msg = memnew(MTMidiMsg(ticks, status_byte, bytes_read));
-        if (bytes_read == 2)
-        {
-            new_msg->msg_bytes[1] = db1;
-            new_msg->msg_bytes[2] = db2;
-        }
-        else if (bytes_read == 1)
-        {
-            new_msg->msg_bytes[1] = db1;
-        }
-        return new_msg;
+        store_event(data, length, running_status, channel_prefix, port_prefix, arena, event);
     }
-
-    return nullptr;
+    return length;
 }
 
-MTMidiMsg *MTMidiMsg::read_meta_msg(
-    uint64_t ticks,
-    uint8_t status_byte,
-    MTDataBuffer &buffer,
-    int32_t& bytes_read)
+/// @brief Copies a message of known length into the arena, see decode_event()
+/// @param data Pointer to the status byte, or the first data byte when
+///             running status is in effect
+/// @param length int32_t, length of the message as given by peek_msg_length()
+/// @param running_status uint8_t, status byte of the previous channel message, updated
+/// @param channel_prefix uint8_t, current MIDI channel prefix, updated
+/// @param port_prefix uint8_t, current MIDI port prefix, updated
+/// @param arena MTMidiArena receiving the message bytes
+/// @param event MTMidiEvent receiving the message
+void MTMidiMsg::store_event(
+    const uint8_t *data,
+    int32_t length,
+    uint8_t &running_status,
+    uint8_t &channel_prefix,
+    uint8_t &port_prefix,
+    MTMidiArena &arena,
+    MTMidiEvent &event)
 {
-    bytes_read = 0;
-
-    if (status_byte != NonChMsgType::Meta)
-    {
-        WARN_PRINT_ED(vformat("Unrecognized event type while reading MTMidiMsg: %d", status_byte ));
-        return nullptr;
-    }
-
-    uint8_t meta_type;
-    if (buffer.read_byte(meta_type) == Error::OK)
-    {
-        ++bytes_read;
-
-        uint32_t vlLength;
-        uint32_t vlValue;
-        if (buffer.read_variable_length(vlValue, vlLength) == Error::OK)
-        {
-            bytes_read += vlLength;
-
-            Error result;
-            PackedByteArray tmp_buffer = buffer.read_bytes(vlValue, result);
-            if (result == Error::OK)
-            {
-                bytes_read += vlValue;
-                MTMidiMsg *msg = memnew(MTMidiMsg(ticks, status_byte, 0));
-                msg->msg_bytes.append(meta_type);
-                PackedByteArray tmp = MTMidiFileStream::uint32_to_variable_length(vlValue);
-                msg->msg_bytes.append_array(tmp);
-                msg->msg_bytes.append_array(tmp_buffer);
-                msg->data_length = vlValue;
-                msg->data_start = 2 + tmp.size();
-                return msg;
-            }
-        }
-    }
-
-    WARN_PRINT_ED("Ran out of data while reading MTMidiMsg");
-    bytes_read = -1;
-    return nullptr;
+    uint8_t *bytes = arena.allocate(mtcore::get_stored_length(data, length));
+    uint32_t stored_length = mtcore::store_msg(data, length, running_status, bytes);
+    mtcore::init_event(bytes, stored_length, channel_prefix, port_prefix, event);
 }
 
-MTMidiMsg *MTMidiMsg::read_sysex_msg(
-    uint64_t ticks,
-    uint8_t status_byte,
-    MTDataBuffer &buffer,
-    int32_t &bytes_read)
+/// @brief Creates a message object holding a copy of an event
+/// @param event MTMidiEvent to copy
+/// @return Pointer to a new MTMidiMsg, owned by the caller
+MTMidiMsg *MTMidiMsg::create_from_event(const MTMidiEvent &event)
 {
-    bytes_read = 0;
-
-    if ((status_byte != NonChMsgType::SysexStart) &&
-        (status_byte != NonChMsgType::SysexContOrEsc))
-    {
-        WARN_PRINT_ED(vformat("Unrecognized event type while reading MTMidiMsg: %d", status_byte));
-        bytes_read = -1;
-        return nullptr;
-    }
-
-    uint32_t vlLength;
-    uint32_t vlValue;
-    if (buffer.read_variable_length(vlValue, vlLength) == Error::OK)
-    {
-        bytes_read += vlLength;
-
-        Error result;
-        PackedByteArray tmp_buffer = buffer.read_bytes(vlValue, result);
-        if (result == Error::OK)
-        {
-            bytes_read += vlValue;
-            MTMidiMsg *msg = memnew(MTMidiMsg(ticks, status_byte, 0));
-            PackedByteArray tmp = MTMidiFileStream::uint32_to_variable_length(vlValue);
-            msg->msg_bytes.append_array(tmp);
-            msg->msg_bytes.append_array(tmp_buffer);
-            msg->data_length = vlValue;
-            msg->data_start = 1 + tmp.size();
-            return msg;
-        }
-    }
-
-    WARN_PRINT_ED("Not enough data while reading MTMidiMsg");
-    bytes_read = -1;
-    return nullptr;
+    MTMidiMsg *msg = memnew(MTMidiMsg());
+    msg->tick = event.tick;
+    msg->msg_bytes.resize(event.length);
+    memcpy(msg->msg_bytes.ptrw(), event.bytes, event.length);
+    msg->data_length = event.data_length;
+    msg->data_start = event.data_start;
+    msg->channel_prefix = event.channel_prefix;
+    msg->port_prefix = event.port_prefix;
+    return msg;
 }
 
 PackedByteArray MTMidiMsg::to_array(uint64_t &currentTick)
@@ -4,16 +4,22 @@
 #include <godot_cpp/classes/node.hpp>
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/variant/packed_byte_array.hpp>
-#include "mt_data_buffer.hpp"
+#include <godot_cpp/templates/safe_refcount.hpp>
+#include "mt_midi_arena.hpp"
+#include "mt_smf.hpp"
 
 namespace godot {
 
+// Compact form of a message as stored by MTMidiTrack.  'bytes' has the same
+// layout as MTMidiMsg::msg_bytes and points into the MTMidiArena of the file.
+typedef mtcore::SmfEvent MTMidiEvent;
+
 class MTMidiMsg : public Node {
 	GDCLASS(MTMidiMsg, Node)
 
 private:
-    static uint64_t next_msg_id;
-	uint64_t id;
+    static SafeNumeric<uint64_t> next_msg_id;
+	uint64_t id = 0;            // 0 until get_id() is first called
 
 protected:
 	static void _bind_methods();
@@ -140,22 +146,22 @@ public:
 
 	uint64_t tick;
 	PackedByteArray msg_bytes;
-	int32_t data_length;
-	int32_t data_start;
-	uint8_t channel_prefix;
-	uint8_t port_prefix;
+	int32_t data_length = 0;
+	int32_t data_start = 0;
+	uint8_t channel_prefix = 0;
+	uint8_t port_prefix = 0;
 
 	MTMidiMsg();
     MTMidiMsg(uint64_t tick, uint8_t statusByte, int32_t dataLength);
     MTMidiMsg(uint64_t tick, PackedByteArray msg_as_bytes);
     //~MTMidiMsg();
-    uint64_t get_id() { return id; }
+    uint64_t get_id();
     uint64_t get_tick() { return tick; }
 	int32_t get_data_length() { return data_length; }
 	int32_t get_data_start() { return data_start; }
 	uint8_t get_channel_prefix() { return channel_prefix; }
 	uint8_t get_port_prefix() { return port_prefix; }
-    static bool is_status_byte(uint8_t byte) { return (byte & 0x80) != 0; };
+    static bool is_status_byte(uint8_t byte) { return mtcore::is_status_byte(byte); };
     int32_t get_status_byte();
     int32_t get_note_value();
     int32_t get_note_velocity();
@@ -166,10 +172,20 @@ public:
     PackedByteArray copy_binary_data();
     uint8_t get_meta_msg_type();
     String get_meta_msg_text();
-    static MTMidiMsg *read_msg(uint64_t tick, uint8_t& running_status, uint8_t& channel_prefix, uint8_t& port_prefix, MTDataBuffer &buffer, int32_t& bytes_read);
-    static MTMidiMsg *read_channel_msg(uint64_t tick, uint8_t s_byte, MTDataBuffer &buffer, int32_t& bytes_read);
-    static MTMidiMsg *read_meta_msg(uint64_t tick, uint8_t s_byte, MTDataBuffer &buffer, int32_t& bytes_read);
-    static MTMidiMsg *read_sysex_msg(uint64_t tick, uint8_t s_byte, MTDataBuffer &buffer, int32_t& bytes_read);
+    static int32_t peek_variable_length(const uint8_t *data, uint64_t available, uint32_t &value) { return mtcore::peek_variable_length(data, available, value); }
+    static int32_t store_variable_length(uint32_t value, uint8_t *data) { return mtcore::store_variable_length(value, data); }
+    static int32_t peek_msg_length(const uint8_t *data, uint64_t available, uint8_t running_status) { return mtcore::peek_msg_length(data, available, running_status); }
+    static int32_t decode_event(const uint8_t *data, uint64_t available, uint8_t &running_status,
+                                uint8_t &channel_prefix, uint8_t &port_prefix, MTMidiArena &arena, MTMidiEvent &event);
+    static void store_event(const uint8_t *data, int32_t length, uint8_t &running_status,
+                            uint8_t &channel_prefix, uint8_t &port_prefix, MTMidiArena &arena, MTMidiEvent &event);
+    static int64_t get_encoded_length(uint8_t status, const uint8_t *data, int64_t length) { return mtcore::get_encoded_length(status, data, length); }
+    static uint32_t encode_msg(uint8_t status, const uint8_t *data, uint32_t length, uint8_t *bytes) { return mtcore::encode_msg(status, data, length, bytes); }
+    static void init_event(uint8_t *bytes, uint32_t length, uint8_t &channel_prefix, uint8_t &port_prefix, MTMidiEvent &event)
+    {
+        mtcore::init_event(bytes, length, channel_prefix, port_prefix, event);
+    }
+    static MTMidiMsg *create_from_event(const MTMidiEvent &event);
     PackedByteArray to_array(uint64_t &current_tick);
     int32_t length_in_bytes(uint64_t &current_tick);
     int32_t read_tempo();
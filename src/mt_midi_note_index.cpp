@@ -0,0 +1,148 @@
+#include "mt_midi_note_index.hpp"
+
+using namespace godot;
+
+/// @brief Adds the note spans of a track, finish() must be called afterwards
+/// @param track_id uint32_t, id reported for the notes of the track
+/// @param track Pointer to the MTMidiTrack
+void MTMidiNoteIndex::add_track(uint32_t track_id, MTMidiTrack *track)
+{
+    const Vector<MTMidiTrack::NoteSpan> &spans = track->get_note_spans();
+    int64_t first = notes.size();
+    notes.resize(first + spans.size());
+    Note *note = notes.ptrw() + first;
+    for (const MTMidiTrack::NoteSpan &span : spans)
+    {
+        note->start_tick = span.start_tick;
+        note->end_tick = span.end_tick;
+        note->track_id = track_id;
+        note->channel = span.channel;
+        note->key = span.key;
+        note->velocity = span.velocity;
+        ++note;
+    }
+}
+
+/// @brief Sorts the notes and builds the tree used by query()
+void MTMidiNoteIndex::finish()
+{
+    // Spans of a single track are already in start order
+    bool sorted = true;
+    for (int64_t i = 1; (i < notes.size()) && sorted; ++i)
+    {
+        sorted = !(notes[i] < notes[i - 1]);
+    }
+    if (!sorted)
+    {
+        notes.sort();
+    }
+
+    int64_t leaves_needed = (notes.size() + LEAF_SIZE - 1) / LEAF_SIZE;
+    leaf_count = 1;
+    while (leaf_count < leaves_needed)
+    {
+        leaf_count <<= 1;
+    }
+
+    max_end_ticks.resize(leaf_count * 2);
+    uint64_t *max_end = max_end_ticks.ptrw();
+    memset(max_end, 0, leaf_count * 2 * sizeof(uint64_t));
+    for (int64_t i = 0; i < notes.size(); ++i)
+    {
+        uint64_t &leaf = max_end[leaf_count + i / LEAF_SIZE];
+        uint64_t end = sounding_end(notes[i]);
+        leaf = end > leaf ? end : leaf;
+    }
+    for (int32_t node = leaf_count - 1; node > 0; --node)
+    {
+        uint64_t left = max_end[node * 2];
+        uint64_t right = max_end[node * 2 + 1];
+        max_end[node] = left > right ? left : right;
+    }
+}
+
+/// @brief Finds the notes sounding in a range of ticks
+/// A note sounds in the range when it starts before 'to_tick' and ends after
+/// 'from_tick'.  Notes without length are treated as one tick long.
+/// An empty range finds the notes sounding at 'from_tick'.
+/// @param from_tick uint64_t, first tick of the range
+/// @param to_tick uint64_t, tick after the range
+/// @param indices Vector receiving the indices of the notes, in start order
+/// @return int64_t, number of notes found
+int64_t MTMidiNoteIndex::query(uint64_t from_tick, uint64_t to_tick, Vector<int32_t> &indices) const
+{
+    indices.clear();
+    if (to_tick <= from_tick)
+    {
+        to_tick = from_tick + 1;
+    }
+    if (notes.is_empty() || (max_end_ticks[1] <= from_tick))
+    {
+        return 0;
+    }
+
+    // Only notes before 'end' start before 'to_tick'
+    int64_t low = 0;
+    int64_t end = notes.size();
+    while (low < end)
+    {
+        int64_t mid = (low + end) / 2;
+        if (notes[mid].start_tick < to_tick)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            end = mid;
+        }
+    }
+    if (end == 0)
+    {
+        return 0;
+    }
+
+    // Depth first, left to right, so notes come out in start order
+    const uint64_t *max_end = max_end_ticks.ptr();
+    int32_t last_leaf = (end - 1) / LEAF_SIZE;
+    int32_t stack[64];
+    int32_t depth = 0;
+    stack[depth++] = 1;
+    while (depth > 0)
+    {
+        int32_t node = stack[--depth];
+        if (max_end[node] <= from_tick)
+        {
+            continue;
+        }
+
+        // First leaf below the node
+        int32_t first_leaf = node;
+        while (first_leaf < leaf_count)
+        {
+            first_leaf <<= 1;
+        }
+        first_leaf -= leaf_count;
+        if (first_leaf > last_leaf)
+        {
+            continue;
+        }
+
+        if (node < leaf_count)
+        {
+            stack[depth++] = node * 2 + 1;
+            stack[depth++] = node * 2;
+            continue;
+        }
+
+        int64_t first = (int64_t)first_leaf * LEAF_SIZE;
+        int64_t last = first + LEAF_SIZE < end ? first + LEAF_SIZE : end;
+        for (int64_t i = first; i < last; ++i)
+        {
+            if (sounding_end(notes[i]) > from_tick)
+            {
+                indices.push_back(i);
+            }
+        }
+    }
+    return indices.size();
+}
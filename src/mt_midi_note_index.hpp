@@ -0,0 +1,55 @@
+#ifndef MT_MIDI_NOTE_INDEX_H
+#define MT_MIDI_NOTE_INDEX_H
+
+#include <godot_cpp/templates/vector.hpp>
+#include "mt_midi_track.hpp"
+
+namespace godot {
+
+// Interval index over the note spans of one or more tracks, answering
+// "which notes sound between two ticks" without visiting every note.
+// Notes are sorted by start tick and grouped into leaves of LEAF_SIZE notes.
+// A tree over the leaves stores the latest end tick below each node, so a
+// query only descends into groups that contain a note still sounding at its
+// start.  Cost is O(log n) plus the groups holding matching notes.
+class MTMidiNoteIndex {
+    public:
+    struct Note {
+        uint64_t start_tick;
+        uint64_t end_tick;
+        uint32_t track_id;
+        uint8_t channel;
+        uint8_t key;
+        uint8_t velocity;
+
+        bool operator<(const Note &other) const
+        {
+            if (start_tick != other.start_tick)
+            {
+                return start_tick < other.start_tick;
+            }
+            return track_id != other.track_id ? track_id < other.track_id : key < other.key;
+        }
+    };
+
+    static const int32_t LEAF_SIZE = 16;
+
+    private:
+    Vector<Note> notes;             // Sorted by start tick
+    Vector<uint64_t> max_end_ticks; // Tree over the leaves, root at 1, leaves from leaf_count
+    int32_t leaf_count = 0;
+
+    // Notes without length still sound at their start tick
+    static uint64_t sounding_end(const Note &note) { return note.end_tick > note.start_tick ? note.end_tick : note.start_tick + 1; }
+
+    public:
+    void add_track(uint32_t track_id, MTMidiTrack *track);
+    void finish();
+
+    int64_t get_note_count() const { return notes.size(); }
+    const Note &get_note(int64_t index) const { return notes[index]; }
+    int64_t query(uint64_t from_tick, uint64_t to_tick, Vector<int32_t> &indices) const;
+};
+
+}
+#endif
@@ -0,0 +1,320 @@
+#include "mt_midi_seek_index.hpp"
+#include "mt_midi_track_merger.hpp"
+
+using namespace godot;
+
+/// @brief Clears the state of all channels
+void MTMidiChaseState::reset()
+{
+    for (Channel &ch : channels)
+    {
+        memset(ch.cc, 0, sizeof(ch.cc));
+        ch.cc_set[0] = 0;
+        ch.cc_set[1] = 0;
+        ch.program = 0;
+        ch.pressure = 0;
+        ch.pitch_bend = 0x2000;
+        ch.rpn_msb = 0x7F;
+        ch.rpn_lsb = 0x7F;
+        memset(ch.rpn_values, 0, sizeof(ch.rpn_values));
+        ch.rpn_set = 0;
+        ch.program_set = false;
+        ch.pressure_set = false;
+        ch.pitch_bend_set = false;
+        ch.used = false;
+    }
+}
+
+/// @brief Updates the channel state with a message
+/// Non-channel messages and notes only mark the channel as used.
+/// Controllers which are actions rather than state (data increment, channel
+/// mode messages) are not chased.  RPN data entry is chased for the
+/// pitch bend range, fine tuning and coarse tuning parameters.
+/// @param event MTMidiEvent to apply
+void MTMidiChaseState::apply(const MTMidiEvent &event)
+{
+    const uint8_t *bytes = event.bytes;
+    if ((event.length < 2) || !event.is_channel_msg())
+    {
+        return;
+    }
+
+    uint8_t type = bytes[0] & 0xF0;
+    Channel &ch = channels[bytes[0] & 0x0F];
+    uint8_t db1 = bytes[1] & 0x7F;
+    uint8_t db2 = event.length > 2 ? bytes[2] & 0x7F : 0;
+    ch.used = true;
+
+    switch (type)
+    {
+        case MTMidiMsg::ChannelMsgType::ProgramChange:
+            ch.program = db1;
+            ch.program_set = true;
+            break;
+        case MTMidiMsg::ChannelMsgType::ChannelPressure:
+            ch.pressure = db1;
+            ch.pressure_set = true;
+            break;
+        case MTMidiMsg::ChannelMsgType::PitchBend:
+            ch.pitch_bend = (db2 << 7) | db1;
+            ch.pitch_bend_set = true;
+            break;
+        case MTMidiMsg::ChannelMsgType::ControlChange:
+            switch (db1)
+            {
+                case MTMidiMsg::CCController::RegParamNumberMSB:
+                    ch.rpn_msb = db2;
+                    break;
+                case MTMidiMsg::CCController::RegParamNumberLSB:
+                    ch.rpn_lsb = db2;
+                    break;
+                case MTMidiMsg::CCController::NonRegParamNumberMSB:
+                case MTMidiMsg::CCController::NonRegParamNumberLSB:
+                    // Data entry now targets an NRPN
+                    ch.rpn_msb = 0x7F;
+                    ch.rpn_lsb = 0x7F;
+                    break;
+                case MTMidiMsg::CCController::DataEntryMSB:
+                    if ((ch.rpn_msb == 0) && (ch.rpn_lsb < 3))
+                    {
+                        ch.rpn_values[ch.rpn_lsb] = db2;
+                        ch.rpn_set |= 1 << ch.rpn_lsb;
+                    }
+                    break;
+                case MTMidiMsg::CCController::DataEntryLSB:
+                case MTMidiMsg::CCController::DataIncrement:
+                case MTMidiMsg::CCController::DataDecrement:
+                    break;
+                case MTMidiMsg::CCController::ChMode_ResetAllCtrls:
+                {
+                    // Controllers reset by RP-015, pitch bend and pressure
+                    static const uint8_t reset_ccs[] = { 0x01, 0x02, 0x04, 0x0B, 0x40, 0x41, 0x42, 0x43 };
+                    for (uint8_t cc : reset_ccs)
+                    {
+                        ch.cc_set[cc >> 6] &= ~(1ULL << (cc & 0x3F));
+                    }
+                    ch.pitch_bend = 0x2000;
+                    ch.pitch_bend_set = false;
+                    ch.pressure_set = false;
+                    ch.rpn_msb = 0x7F;
+                    ch.rpn_lsb = 0x7F;
+                    break;
+                }
+                default:
+                    if (db1 < MTMidiMsg::CCController::ChMode_AllSoundOff)
+                    {
+                        ch.cc[db1] = db2;
+                        ch.cc_set[db1 >> 6] |= 1ULL << (db1 & 0x3F);
+                    }
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/// @brief Appends the messages restoring the state of all used channels
+/// The output uses the same layout as MTFluidSynthNode.synth_play_messages,
+/// 'indices' receiving the start offset of each message in 'data'.
+/// Each used channel first gets All Notes Off and Reset All Controllers,
+/// followed by bank select, program, controllers, RPNs, pitch bend and pressure.
+/// @param indices PackedInt32Array receiving message offsets
+/// @param data PackedByteArray receiving message bytes
+/// @return int32_t, number of messages appended
+int32_t MTMidiChaseState::append_msgs(PackedInt32Array &indices, PackedByteArray &data) const
+{
+    int32_t count = 0;
+
+    auto append = [&](uint8_t status, uint8_t db1, int32_t db2) {
+        indices.append(data.size());
+        data.append(status);
+        data.append(db1);
+        if (db2 >= 0)
+        {
+            data.append(db2);
+        }
+        ++count;
+    };
+
+    for (uint8_t channel = 0; channel < 16; ++channel)
+    {
+        const Channel &ch = channels[channel];
+        if (!ch.used)
+        {
+            continue;
+        }
+
+        uint8_t cc_status = MTMidiMsg::ChannelMsgType::ControlChange | channel;
+        append(cc_status, MTMidiMsg::CCController::ChMode_AllNotesOff, 0);
+        append(cc_status, MTMidiMsg::CCController::ChMode_ResetAllCtrls, 0);
+
+        auto is_cc_set = [&ch](uint8_t cc) { return (ch.cc_set[cc >> 6] >> (cc & 0x3F)) & 1; };
+
+        // Bank select must precede the program change to take effect
+        if (is_cc_set(MTMidiMsg::CCController::BankSelect))
+        {
+            append(cc_status, MTMidiMsg::CCController::BankSelect, ch.cc[MTMidiMsg::CCController::BankSelect]);
+        }
+        if (is_cc_set(MTMidiMsg::CCController::BankSelectLSB))
+        {
+            append(cc_status, MTMidiMsg::CCController::BankSelectLSB, ch.cc[MTMidiMsg::CCController::BankSelectLSB]);
+        }
+        if (ch.program_set)
+        {
+            append(MTMidiMsg::ChannelMsgType::ProgramChange | channel, ch.program, -1);
+        }
+
+        for (uint8_t cc = 0; cc < MTMidiMsg::CCController::ChMode_AllSoundOff; ++cc)
+        {
+            if ((cc != MTMidiMsg::CCController::BankSelect) &&
+                (cc != MTMidiMsg::CCController::BankSelectLSB) &&
+                is_cc_set(cc))
+            {
+                append(cc_status, cc, ch.cc[cc]);
+            }
+        }
+
+        if (ch.rpn_set != 0)
+        {
+            for (uint8_t rpn = 0; rpn < 3; ++rpn)
+            {
+                if (ch.rpn_set & (1 << rpn))
+                {
+                    append(cc_status, MTMidiMsg::CCController::RegParamNumberMSB, 0);
+                    append(cc_status, MTMidiMsg::CCController::RegParamNumberLSB, rpn);
+                    append(cc_status, MTMidiMsg::CCController::DataEntryMSB, ch.rpn_values[rpn]);
+                }
+            }
+            // Deselect, so stray data entry messages don't change the RPNs
+            append(cc_status, MTMidiMsg::CCController::RegParamNumberMSB, 0x7F);
+            append(cc_status, MTMidiMsg::CCController::RegParamNumberLSB, 0x7F);
+        }
+
+        if (ch.pitch_bend_set)
+        {
+            append(MTMidiMsg::ChannelMsgType::PitchBend | channel, ch.pitch_bend & 0x7F, ch.pitch_bend >> 7);
+        }
+        if (ch.pressure_set)
+        {
+            append(MTMidiMsg::ChannelMsgType::ChannelPressure | channel, ch.pressure, -1);
+        }
+    }
+
+    return count;
+}
+
+/// @brief Returns the slot of the track holding the next message in tick order
+/// Ties are resolved in favour of the lowest slot, i.e. the earliest track.
+/// @return int32_t, track slot, or -1 when all tracks are exhausted
+int32_t MTMidiSeekIndex::next_track(const Cursor &cursor) const
+{
+    int32_t next = -1;
+    uint64_t next_tick = 0;
+    for (int32_t slot = 0; slot < tracks.size(); ++slot)
+    {
+        int64_t position = cursor.positions[slot];
+        if (position >= tracks[slot]->get_event_count())
+        {
+            continue;
+        }
+        uint64_t tick = tracks[slot]->get_event(position).tick;
+        if ((next == -1) || (tick < next_tick))
+        {
+            next = slot;
+            next_tick = tick;
+        }
+    }
+    return next;
+}
+
+/// @brief Steps the given track slot to its next message
+/// @param cursor Cursor to step
+/// @param track int32_t, track slot returned by next_track()
+/// @return MTMidiEvent stepped over
+const MTMidiEvent &MTMidiSeekIndex::advance(Cursor &cursor, int32_t track) const
+{
+    return tracks[track]->get_event(cursor.positions.write[track]++);
+}
+
+/// @brief Builds checkpoints over all tracks of a file
+/// The index refers to the tracks' messages directly and must be rebuilt
+/// whenever tracks or messages are added or removed.
+/// @param tracks Tracks of the file, merged in map order
+/// @param interval uint32_t, number of merged messages between checkpoints
+MTMidiSeekIndex::MTMidiSeekIndex(const HashMap<uint32_t, MTMidiTrack*> &tracks, uint32_t interval) :
+    interval(interval > 0 ? interval : 1)
+{
+    Cursor cursor;
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        track_ids.push_back(element.key);
+        this->tracks.push_back(element.value);
+        cursor.positions.push_back(0);
+    }
+
+    MTMidiChaseState state;
+    uint64_t merged_count = 0;
+    MTMidiTrackMerger merger(tracks);
+    const MTMidiEvent *event;
+    while ((event = merger.next()) != nullptr)
+    {
+        if ((merged_count % this->interval) == 0)
+        {
+            Checkpoint checkpoint;
+            checkpoint.tick = event->tick;
+            checkpoint.cursor = cursor;
+            checkpoint.state = state;
+            checkpoints.push_back(checkpoint);
+        }
+
+        state.apply(*event);
+        ++cursor.positions.write[merger.get_slot()];
+        ++merged_count;
+    }
+}
+
+/// @brief Finds where playback continues at a tick, and the state to chase
+/// Starts from the last checkpoint before the tick and replays at most
+/// 'interval' messages.  Messages at exactly 'tick' are not applied, they
+/// are the first ones to be played from the returned cursor.
+/// @param tick uint64_t, tick to seek to
+/// @param cursor Cursor receiving the next message position of every track
+/// @param state MTMidiChaseState receiving the channel state at the tick
+/// @return bool, false if the index contains no messages
+bool MTMidiSeekIndex::seek(uint64_t tick, Cursor &cursor, MTMidiChaseState &state) const
+{
+    if (checkpoints.is_empty())
+    {
+        return false;
+    }
+
+    // Last checkpoint strictly before the tick, or the first one
+    int64_t low = 0;
+    int64_t high = checkpoints.size() - 1;
+    while (low < high)
+    {
+        int64_t mid = (low + high + 1) / 2;
+        if (checkpoints[mid].tick < tick)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    const Checkpoint &checkpoint = checkpoints[low];
+    cursor = checkpoint.cursor;
+    state = checkpoint.state;
+
+    int32_t track = next_track(cursor);
+    while ((track != -1) && (tracks[track]->get_event(cursor.positions[track]).tick < tick))
+    {
+        state.apply(advance(cursor, track));
+        track = next_track(cursor);
+    }
+
+    return true;
+}
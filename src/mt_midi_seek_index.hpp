@@ -0,0 +1,76 @@
+#ifndef MT_MIDI_SEEK_INDEX_H
+#define MT_MIDI_SEEK_INDEX_H
+
+#include <godot_cpp/templates/vector.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include "mt_midi_msg.hpp"
+#include "mt_midi_track.hpp"
+
+namespace godot {
+
+// Channel state that has to be restored when playback starts somewhere other
+// than the beginning of a file: programs, controllers, RPNs, pitch bend and
+// channel pressure of all 16 channels.
+class MTMidiChaseState {
+    public:
+    struct Channel {
+        uint8_t cc[128];
+        uint64_t cc_set[2];
+        uint8_t program;
+        uint8_t pressure;
+        uint16_t pitch_bend;
+        uint8_t rpn_msb;
+        uint8_t rpn_lsb;
+        uint8_t rpn_values[3];
+        uint8_t rpn_set;
+        bool program_set;
+        bool pressure_set;
+        bool pitch_bend_set;
+        bool used;
+    };
+
+    Channel channels[16];
+
+    MTMidiChaseState() { reset(); }
+    void reset();
+    void apply(const MTMidiEvent &event);
+    int32_t append_msgs(PackedInt32Array &indices, PackedByteArray &data) const;
+};
+
+// Checkpoints over the tick ordered merge of all tracks of a file, taken every
+// 'interval' messages. Each checkpoint stores where every track continues and
+// the chase state up to that point, so a seek only replays at most 'interval'
+// messages instead of the whole file.
+class MTMidiSeekIndex {
+    public:
+    struct Cursor {
+        Vector<int64_t> positions;
+    };
+
+    private:
+    struct Checkpoint {
+        uint64_t tick;
+        Cursor cursor;
+        MTMidiChaseState state;
+    };
+
+    Vector<uint32_t> track_ids;
+    Vector<const MTMidiTrack*> tracks;
+    Vector<Checkpoint> checkpoints;
+    uint32_t interval;
+
+    int32_t next_track(const Cursor &cursor) const;
+    const MTMidiEvent &advance(Cursor &cursor, int32_t track) const;
+
+    public:
+    MTMidiSeekIndex(const HashMap<uint32_t, MTMidiTrack*> &tracks, uint32_t interval);
+
+    uint32_t get_interval() const { return interval; }
+    int64_t get_checkpoint_count() const { return checkpoints.size(); }
+    const Vector<uint32_t> &get_track_ids() const { return track_ids; }
+    bool seek(uint64_t tick, Cursor &cursor, MTMidiChaseState &state) const;
+};
+
+}
+#endif
@@ -0,0 +1,324 @@
+#include "mt_midi_stream_parser.hpp"
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/core/memory.hpp>
+
+using namespace godot;
+
+void MTMidiStreamParser::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("begin", "target"), &MTMidiStreamParser::begin);
+	ClassDB::bind_method(D_METHOD("feed", "chunk"), &MTMidiStreamParser::feed);
+	ClassDB::bind_method(D_METHOD("finish"), &MTMidiStreamParser::finish);
+	ClassDB::bind_method(D_METHOD("reset"), &MTMidiStreamParser::reset);
+	ClassDB::bind_method(D_METHOD("get_state"), &MTMidiStreamParser::get_state);
+	ClassDB::bind_method(D_METHOD("is_complete"), &MTMidiStreamParser::is_complete);
+	ClassDB::bind_method(D_METHOD("get_current_track"), &MTMidiStreamParser::get_current_track);
+	ClassDB::bind_method(D_METHOD("get_decoded_tick"), &MTMidiStreamParser::get_decoded_tick);
+	ClassDB::bind_method(D_METHOD("get_bytes_received"), &MTMidiStreamParser::get_bytes_received);
+	ClassDB::bind_method(D_METHOD("get_last_error"), &MTMidiStreamParser::get_last_error);
+}
+
+/// @brief Starts parsing a new file into the given MTMidiFile
+/// Tracks are added to the file as soon as their chunk header arrives, and
+/// messages are appended to them as they are decoded, so the file can be
+/// played up to get_decoded_tick() while the rest is still being received.
+/// The parsing limits of the target apply, see MTMidiFile.set_strict_parsing().
+/// The parser keeps a reference to the target until finish() or reset().
+/// @param target Ref to an MTMidiFile without tracks
+/// @return bool, true if parsing can start
+bool MTMidiStreamParser::begin(const Ref<MTMidiFile> &target)
+{
+    if (target.is_null())
+    {
+        WARN_PRINT_ED("MTMidiStreamParser: No target MTMidiFile");
+        return false;
+    }
+
+    if (target->tracks.size() > 0)
+    {
+        WARN_PRINT_ED("MTMidiStreamParser: Target MTMidiFile already contains tracks");
+        return false;
+    }
+
+    file = target;
+    track = nullptr;
+    pending.clear();
+    pending_index = 0;
+    state = ParseState::FileHeader;
+    chunk_remaining = 0;
+    tracks_read = 0;
+    tick = 0;
+    running_status = 0;
+    channel_prefix = 0;
+    port_prefix = 0;
+    bytes_received = 0;
+    event_count = 0;
+    last_error = Error::OK;
+    return true;
+}
+
+/// @brief Parses the next chunk of file data
+/// Chunks may be split at any byte, incomplete messages are kept until the
+/// rest of their data arrives.
+/// @param chunk PackedByteArray, next bytes of the file
+/// @return int64_t, number of messages decoded, -1 on error
+int64_t MTMidiStreamParser::feed(PackedByteArray chunk)
+{
+    if ((state == ParseState::Idle) || (state == ParseState::Failed))
+    {
+        WARN_PRINT_ED("MTMidiStreamParser: begin() must be called before feeding data");
+        return -1;
+    }
+
+    bytes_received += chunk.size();
+    if (state == ParseState::Complete)
+    {
+        return 0;
+    }
+
+    if (bytes_received > file->limits.max_file_size)
+    {
+        WARN_PRINT_ED(vformat("MTMidiStreamParser: File exceeds the parsing limits: %d bytes", bytes_received));
+        fail(Error::ERR_PARAMETER_RANGE_ERROR);
+        return -1;
+    }
+
+    pending.append_array(chunk);
+
+    int64_t msg_count = 0;
+    bool progress = true;
+    while (progress)
+    {
+        switch (state)
+        {
+            case ParseState::FileHeader:
+                progress = parse_file_header();
+                break;
+            case ParseState::ChunkHeader:
+                progress = parse_chunk_header();
+                break;
+            case ParseState::TrackData:
+                progress = parse_track_data(msg_count);
+                break;
+            case ParseState::SkipChunk:
+                progress = skip_chunk_data();
+                break;
+            default:
+                progress = false;
+                break;
+        }
+    }
+
+    // Only keep the bytes of an incomplete header or message
+    if (pending_index > 0)
+    {
+        pending = pending.slice(pending_index, pending.size());
+        pending_index = 0;
+    }
+
+    return state == ParseState::Failed ? -1 : msg_count;
+}
+
+/// @brief Ends parsing, checking that the whole file was received
+/// The target MTMidiFile is released.
+/// @return bool, true if all tracks were completely decoded
+bool MTMidiStreamParser::finish()
+{
+    pending.clear();
+    pending_index = 0;
+
+    if ((state != ParseState::Complete) && (state != ParseState::Failed) && file.is_valid())
+    {
+        WARN_PRINT_ED(vformat("MTMidiStreamParser: Data ended in track %d of %d", tracks_read, file->track_count));
+        fail(Error::ERR_FILE_EOF);
+    }
+    file.unref();
+    track = nullptr;
+    return state == ParseState::Complete;
+}
+
+/// @brief Stops parsing and releases the target MTMidiFile
+/// Tracks decoded so far stay in the file.
+void MTMidiStreamParser::reset()
+{
+    file.unref();
+    track = nullptr;
+    pending.clear();
+    pending_index = 0;
+    state = ParseState::Idle;
+}
+
+void MTMidiStreamParser::fail(Error error)
+{
+    last_error = error;
+    file->last_error = error;
+    state = ParseState::Failed;
+    track = nullptr;
+}
+
+bool MTMidiStreamParser::parse_file_header()
+{
+    uint64_t available = pending.size() - pending_index;
+    if (available < 8)
+    {
+        return false;
+    }
+
+    const uint8_t *data = pending.ptr() + pending_index;
+    uint32_t chunk_length = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+    MIDIChunkHeader header(data, chunk_length);
+
+    if ((header.chunk_type != MIDIChunkHeader::HeaderType::File) || (chunk_length != 6))
+    {
+        WARN_PRINT_ED("MTMidiStreamParser: Data does not start with a valid MThd chunk");
+        fail(Error::ERR_FILE_UNRECOGNIZED);
+        return false;
+    }
+
+    if (available < 8 + chunk_length)
+    {
+        return false;
+    }
+
+    header.header_data = pending.slice(pending_index + 8, pending_index + 8 + chunk_length);
+    if (!file->apply_file_header(header))
+    {
+        fail(file->get_last_error());
+        return false;
+    }
+
+    if (file->track_count > file->limits.max_tracks)
+    {
+        WARN_PRINT_ED(vformat("MTMidiStreamParser: File exceeds the parsing limits: %d tracks", file->track_count));
+        fail(Error::ERR_PARAMETER_RANGE_ERROR);
+        return false;
+    }
+
+    pending_index += 8 + chunk_length;
+    state = file->track_count > 0 ? ParseState::ChunkHeader : ParseState::Complete;
+    return true;
+}
+
+bool MTMidiStreamParser::parse_chunk_header()
+{
+    if (pending.size() - pending_index < 8)
+    {
+        return false;
+    }
+
+    const uint8_t *data = pending.ptr() + pending_index;
+    uint32_t chunk_length = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+    MIDIChunkHeader header(data, chunk_length);
+    pending_index += 8;
+    chunk_remaining = chunk_length;
+
+    if (header.chunk_type == MIDIChunkHeader::HeaderType::Track)
+    {
+        track = memnew(MTMidiTrack(tracks_read, &file->arena));
+        file->tracks.insert(tracks_read, track);
+        tick = 0;
+        running_status = 0;
+        channel_prefix = 0;
+        port_prefix = 0;
+        state = ParseState::TrackData;
+    }
+    else
+    {
+        // Unknown chunks are skipped, and don't count as tracks
+        WARN_PRINT_ED(vformat("MTMidiStreamParser: Skipping chunk with unrecognized header type: %d", header.chunk_type));
+        state = ParseState::SkipChunk;
+    }
+    return true;
+}
+
+bool MTMidiStreamParser::parse_track_data(int64_t &msg_count)
+{
+    bool success = true;
+    bool limit_exceeded = false;
+    bool progress = false;
+
+    while (success && (chunk_remaining > 0))
+    {
+        uint64_t available = MIN((uint64_t)(pending.size() - pending_index), (uint64_t)chunk_remaining);
+        const uint8_t *data = pending.ptr() + pending_index;
+
+        uint32_t tick_delta;
+        MTMidiEvent event;
+        int32_t delta_size = MTMidiMsg::peek_variable_length(data, available, tick_delta);
+        int32_t msg_size = delta_size > 0 ?
+            MTMidiMsg::decode_event(data + delta_size, available - delta_size, running_status,
+                                    channel_prefix, port_prefix, file->arena, event) : delta_size;
+
+        if (msg_size == 0)
+        {
+            if (available == chunk_remaining)
+            {
+                WARN_PRINT_ED(vformat("MTMidiStreamParser: Message crosses the end of track %d", tracks_read));
+                success = false;
+            }
+            else if (available > (uint64_t)file->limits.max_message_length + 16)
+            {
+                // Don't keep buffering a message that will exceed the limits
+                WARN_PRINT_ED(vformat("MTMidiStreamParser: Message in track %d exceeds the parsing limits", tracks_read));
+                limit_exceeded = true;
+                success = false;
+            }
+            // Otherwise wait for the rest of the message
+            break;
+        }
+
+        if (msg_size < 0)
+        {
+            WARN_PRINT_ED(vformat("MTMidiStreamParser: Unrecoverable error reading MIDI message in track %d", tracks_read));
+            success = false;
+            break;
+        }
+
+        if ((event.data_length > file->limits.max_message_length) || (event_count >= file->limits.max_events))
+        {
+            WARN_PRINT_ED(vformat("MTMidiStreamParser: Track %d exceeds the parsing limits", tracks_read));
+            limit_exceeded = true;
+            success = false;
+            break;
+        }
+
+        tick += tick_delta;
+        event.tick = tick;
+        track->append_event(event);
+        ++msg_count;
+        ++event_count;
+        pending_index += delta_size + msg_size;
+        chunk_remaining -= delta_size + msg_size;
+        progress = true;
+    }
+
+    if (!success)
+    {
+        fail(limit_exceeded ? Error::ERR_PARAMETER_RANGE_ERROR : Error::ERR_PARSE_ERROR);
+        return false;
+    }
+
+    if (chunk_remaining == 0)
+    {
+        track = nullptr;
+        ++tracks_read;
+        state = tracks_read >= file->track_count ? ParseState::Complete : ParseState::ChunkHeader;
+        return true;
+    }
+
+    return progress;
+}
+
+bool MTMidiStreamParser::skip_chunk_data()
+{
+    uint64_t skip = MIN((uint64_t)(pending.size() - pending_index), (uint64_t)chunk_remaining);
+    pending_index += skip;
+    chunk_remaining -= skip;
+
+    if (chunk_remaining > 0)
+    {
+        return false;
+    }
+
+    state = ParseState::ChunkHeader;
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef MT_MIDI_STREAM_PARSER_H
+#define MT_MIDI_STREAM_PARSER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include "mt_midi_file.hpp"
+#include "mt_midi_track.hpp"
+
+namespace godot {
+
+class MTMidiStreamParser : public RefCounted {
+    GDCLASS(MTMidiStreamParser, RefCounted)
+
+public:
+    enum ParseState { Idle = 0, FileHeader = 1, ChunkHeader = 2, TrackData = 3, SkipChunk = 4, Complete = 5, Failed = 6 };
+
+private:
+    Ref<MTMidiFile> file;
+    MTMidiTrack *track = nullptr;
+    PackedByteArray pending;
+    uint64_t pending_index = 0;
+    ParseState state = ParseState::Idle;
+    uint32_t chunk_remaining = 0;
+    uint16_t tracks_read = 0;
+    uint64_t tick = 0;
+    uint8_t running_status = 0;
+    uint8_t channel_prefix = 0;
+    uint8_t port_prefix = 0;
+    uint64_t bytes_received = 0;
+    uint64_t event_count = 0;
+    Error last_error = Error::OK;
+
+    bool parse_chunk_header();
+    bool parse_file_header();
+    bool parse_track_data(int64_t &msg_count);
+    bool skip_chunk_data();
+    void fail(Error error);
+
+protected:
+    static void _bind_methods();
+
+public:
+    MTMidiStreamParser() {}
+
+    bool begin(const Ref<MTMidiFile> &target);
+    int64_t feed(PackedByteArray chunk);
+    bool finish();
+    void reset();
+    int get_state() { return state; }
+    bool is_complete() { return state == ParseState::Complete; }
+    int get_current_track() { return tracks_read; }
+    int64_t get_decoded_tick() { return tick; }
+    int64_t get_bytes_received() { return bytes_received; }
+    Error get_last_error() { return last_error; }
+};
+}
+#endif
@@ -1,20 +1,25 @@
 #include "mt_midi_track.hpp"
 #include "mt_midi_file_stream.hpp"
+#include "mt_smf_scanner.hpp"
 
 using namespace godot;
 
-MTMidiTrack::~MTMidiTrack()
-{
-    for (MTMidiMsg* msg : msgs)
-    {
-        memdelete(msg);
-    }
-}
-
+/// @brief Reads the next chunk of the stream as a track
+/// @param file_stream MTMidiFileStream, positioned at a chunk header
+/// @param track_id int, id of the new track
+/// @param arena Pointer to the MTMidiArena receiving the message bytes
+/// @param result Error, ERR_PARAMETER_RANGE_ERROR if a cap of 'limits' is exceeded
+/// @param limits SmfLimits, caps on the message length
+/// @param max_events uint64_t, number of events the track may hold
+/// @return Pointer to a new MTMidiTrack, nullptr on error or if the chunk
+///         is not a track
 MTMidiTrack *MTMidiTrack::read_track(
-    MTMidiFileStream file_stream,
+    MTMidiFileStream &file_stream,
     int track_id,
-    Error& result)
+    MTMidiArena *arena,
+    Error& result,
+    const mtcore::SmfLimits &limits,
+    uint64_t max_events)
 {
     bool success = true;
 
@@ -36,7 +41,7 @@ MTMidiTrack *MTMidiTrack::read_track(
         }
         else
         {
-            result == Error::ERR_FILE_EOF;
+            result = Error::ERR_FILE_EOF;
         }
         return nullptr;
     }
@@ -49,7 +54,7 @@ MTMidiTrack *MTMidiTrack::read_track(
         return nullptr;
     }
 
-    MTMidiTrack* track = memnew(MTMidiTrack(track_id));
+    MTMidiTrack* track = memnew(MTMidiTrack(track_id, arena));
 
     PackedByteArray buffer;
     result = file_stream.read_bytes(header.chunk_length, buffer);
@@ -60,60 +65,40 @@ MTMidiTrack *MTMidiTrack::read_track(
         return nullptr;
     }
 
-    int bytes_read = 0;
-    uint64_t tick = 0;
+    const uint8_t *data = buffer.ptr();
     uint8_t running_status = 0;
     uint8_t channel_prefix = 0;
     uint8_t port_prefix = 0;
-    uint32_t tick_delta;
-    uint32_t delta_size;
 
-    MTDataBuffer *data_buffer = memnew(MTDataBuffer(buffer));                    
-
-    if (data_buffer != nullptr)
-    {
-        // TODO: Add type 2 support: Check for a Sequence Number Meta message, which
-        // must occur before any non-zero tick deltas.
+    // TODO: Add type 2 support: Check for a Sequence Number Meta message, which
+    // must occur before any non-zero tick deltas.
 
-        // TODO: Add SMPTE timecode support: Check for a SMPTE Offset message, which
-        // must occur before any non-zero tick deltas.
+    // TODO: Add SMPTE timecode support: Check for a SMPTE Offset message, which
+    // must occur before any non-zero tick deltas.
 
-        while (success && (data_buffer->unread_count() > 0) && (bytes_read < header.chunk_length))
+    mtcore::SmfEventScanner scanner(data, header.chunk_length);
+    mtcore::SmfEventScanner::Event scanned;
+    while (scanner.next(scanned))
+    {
+        if ((scanned.data_length > limits.max_message_length) || ((uint64_t)track->get_event_count() >= max_events))
         {
-            if (data_buffer->read_variable_length(tick_delta, delta_size) == Error::OK)
-            {
-                bytes_read += delta_size;
-                tick += tick_delta;
-
-                int32_t read_length;
-                MTMidiMsg* readEvt = MTMidiMsg::read_msg(tick, running_status,
-                                        channel_prefix, port_prefix, *data_buffer, read_length);
-
-                if (read_length != -1)
-                {
-                    bytes_read += read_length;
-                    track->msgs.push_back(readEvt);
-                }
-                else
-                {
-                    WARN_PRINT_ED(vformat("Unrecoverable error reading MIDI message in track %d", track_id));
-                    success = false;
-                }
-            }
-            else
-            {
-                WARN_PRINT_ED(vformat("Unrecoverable error reading tick delta VLV in track %d", track_id));
-                success = false;
-            }
+            WARN_PRINT_ED(vformat("MIDI track %d exceeds the parsing limits at offset %d", track_id, scanned.offset));
+            result = Error::ERR_PARAMETER_RANGE_ERROR;
+            memdelete(track);
+            return nullptr;
         }
 
-        memdelete(data_buffer);
+        MTMidiEvent event;
+        MTMidiMsg::store_event(data + scanned.offset, scanned.length,
+            running_status, channel_prefix, port_prefix, *arena, event);
+        event.tick = scanned.tick;
+        track->append_event(event);
     }
 
-    if (bytes_read != header.chunk_length)
+    if (scanner.has_error())
     {
-        WARN_PRINT_ED(vformat("Error in track #%d : Bytes read count %d does not match chunk length %d",
-            String::num_uint64(track_id), bytes_read, header.chunk_length));
+        WARN_PRINT_ED(vformat("Unrecoverable error reading MIDI message in track %d at offset %d",
+            track_id, scanner.get_offset()));
         success = false;
     }
 
@@ -127,81 +112,698 @@ MTMidiTrack *MTMidiTrack::read_track(
     return track;
 }
 
-Error MTMidiTrack::write_events_to_stream(MTMidiFileStream file_stream)
+/// @brief Creates a track from messages in the format of
+/// MTMidiFile.get_track_events(): parallel arrays of ticks and status bytes,
+/// with the data of message i from offsets[i] to offsets[i + 1] in 'data'.
+/// The messages do not need to be sorted, messages with the same tick keep
+/// their order.  End of Track messages in the arrays are dropped and one is
+/// added after the last message, as every track chunk must end with one.
+/// All message bytes are stored in one arena allocation.
+/// @param track_id int, id of the new track
+/// @param arena Pointer to the MTMidiArena receiving the message bytes
+/// @param ticks PackedInt64Array, absolute tick of every message
+/// @param statuses PackedByteArray, status byte of every message
+/// @param offsets PackedInt32Array, one entry more than there are messages
+/// @param data PackedByteArray, data bytes of channel messages, type and
+///             payload of meta messages, payload of sysex messages
+/// @param result Error, ERR_INVALID_PARAMETER if a message is invalid
+/// @return Pointer to a new MTMidiTrack, nullptr on error
+MTMidiTrack *MTMidiTrack::build_track(
+    int track_id,
+    MTMidiArena *arena,
+    const PackedInt64Array &ticks,
+    const PackedByteArray &statuses,
+    const PackedInt32Array &offsets,
+    const PackedByteArray &data,
+    Error& result)
 {
-    uint64_t current_tick = 0;
+    int64_t count = ticks.size();
+    if ((statuses.size() != count) || (offsets.size() != count + 1) ||
+        (offsets[0] < 0) || (offsets[count] > data.size()))
+    {
+        WARN_PRINT_ED("Track event arrays do not match in size");
+        result = Error::ERR_INVALID_PARAMETER;
+        return nullptr;
+    }
+
+    struct Order {
+        uint64_t tick;
+        int64_t index;
+
+        bool operator<(const Order &other) const
+        {
+            return tick != other.tick ? tick < other.tick : index < other.index;
+        }
+    };
 
-    Error result;
-    for (MTMidiMsg* msg : msgs)
+    const int64_t *tick_ptr = ticks.ptr();
+    const uint8_t *status_ptr = statuses.ptr();
+    const int32_t *offset_ptr = offsets.ptr();
+    const uint8_t *data_ptr = data.ptr();
+    Vector<Order> order;
+    order.resize(count);
+    bool sorted = true;
+    uint64_t stored_length = 0;
+    for (int64_t i = 0; i < count; ++i)
     {
-        PackedByteArray data = msg->to_array(current_tick);
-        if (data.size() > 0)
+        int32_t length = offset_ptr[i + 1] - offset_ptr[i];
+        int64_t msg_length = -1;
+        if ((length >= 0) && (offset_ptr[i + 1] <= data.size()))
+        {
+            msg_length = MTMidiMsg::get_encoded_length(status_ptr[i], data_ptr + offset_ptr[i], length);
+        }
+        bool valid = (tick_ptr[i] >= 0) && (msg_length > 0);
+        stored_length += msg_length;
+
+        if (!valid)
         {
-            result = file_stream.write_bytes(data);
+            WARN_PRINT_ED(vformat("Invalid MIDI message %d in track event arrays", i));
+            result = Error::ERR_INVALID_PARAMETER;
+            return nullptr;
         }
+
+        order.write[i].tick = tick_ptr[i];
+        order.write[i].index = i;
+        sorted = sorted && ((i == 0) || (tick_ptr[i] >= tick_ptr[i - 1]));
+    }
+    if (!sorted)
+    {
+        order.sort();
+    }
+
+    // Tick deltas are written as variable length values of at most 4 bytes
+    for (int64_t i = 0; i < count; ++i)
+    {
+        uint64_t delta = order[i].tick - (i > 0 ? order[i - 1].tick : 0);
+        if (delta > 0x0FFFFFFF)
+        {
+            WARN_PRINT_ED(vformat("Tick gap before MIDI message %d in track event arrays is too large", order[i].index));
+            result = Error::ERR_INVALID_PARAMETER;
+            return nullptr;
+        }
+    }
+
+    static const uint8_t end_of_track[1] = { MTMidiMsg::MetaMsgType::EndOfTrack };
+    MTMidiTrack *track = memnew(MTMidiTrack(track_id, arena));
+    uint8_t *bytes = arena->allocate(stored_length + 3);
+    uint8_t channel_prefix = 0;
+    uint8_t port_prefix = 0;
+
+    for (int64_t i = 0; i < count; ++i)
+    {
+        int64_t index = order[i].index;
+        if ((status_ptr[index] == 0xFF) && (offset_ptr[index + 1] > offset_ptr[index]) &&
+            (data_ptr[offset_ptr[index]] == MTMidiMsg::MetaMsgType::EndOfTrack))
+        {
+            continue;
+        }
+
+        uint8_t *msg = bytes;
+        bytes += MTMidiMsg::encode_msg(status_ptr[index], data_ptr + offset_ptr[index],
+            offset_ptr[index + 1] - offset_ptr[index], bytes);
+
+        MTMidiEvent event;
+        MTMidiMsg::init_event(msg, bytes - msg, channel_prefix, port_prefix, event);
+        event.tick = order[i].tick;
+        track->append_event(event);
+    }
+
+    MTMidiEvent event;
+    uint32_t length = MTMidiMsg::encode_msg(0xFF, end_of_track, 1, bytes);
+    MTMidiMsg::init_event(bytes, length, channel_prefix, port_prefix, event);
+    event.tick = count > 0 ? order[count - 1].tick : 0;
+    track->append_event(event);
+
+    track->contains_unsaved_edits = true;
+    result = Error::OK;
+    return track;
+}
+
+Error MTMidiTrack::write_events_to_stream(MTMidiFileStream &file_stream)
+{
+    // The whole track is one buffer, so the stream is written once
+    PackedByteArray data = get_chunk_data();
+    if (data.size() == 0)
+    {
+        return Error::OK;
+    }
+    return file_stream.write_bytes(data);
+}
+
+/// @brief Returns the messages encoded as track chunk data
+/// The data is kept until the track is edited, so saving a file again only
+/// encodes the tracks edited since.
+/// @return PackedByteArray, chunk data without the chunk header
+PackedByteArray MTMidiTrack::get_chunk_data()
+{
+    PackedByteArray data;
+    if (!get_cached_chunk_data(data))
+    {
+        data.resize(measure_events(events));
+        encode_events(events, data.ptrw());
+        cache_chunk_data(events, data);
     }
-    return result;
+    return data;
+}
+
+/// @brief Returns the chunk data kept by get_chunk_data() or cache_chunk_data()
+/// @param data PackedByteArray receiving the data
+/// @return bool, false if the track was edited since the data was encoded
+bool MTMidiTrack::get_cached_chunk_data(PackedByteArray &data) const
+{
+    if (!events.shares_storage(chunk_events) || (chunk_data.is_empty() && !events.is_empty()))
+    {
+        return false;
+    }
+    data = chunk_data;
+    return true;
+}
+
+/// @brief Keeps chunk data encoded elsewhere, e.g. by MTMidiFile::save_async()
+/// @param encoded_events MTMidiEventList, the messages of the data, the data
+///                       is used while the track shares them
+/// @param data PackedByteArray, encoded messages, see encode_events()
+void MTMidiTrack::cache_chunk_data(const MTMidiEventList &encoded_events, const PackedByteArray &data)
+{
+    chunk_events = encoded_events;
+    chunk_data = data;
 }
 
 int MTMidiTrack::get_length_in_bytes()
 {
-    int data_length = 0;
+    return measure_events(events);
+}
+
+/// @brief Measures messages encoded as track chunk data, see encode_events()
+/// @param events MTMidiEventList, messages in tick order
+/// @return uint64_t, length in bytes, without the chunk header
+uint64_t MTMidiTrack::measure_events(const MTMidiEventList &events)
+{
+    uint64_t data_length = 0;
     uint64_t current_tick = 0;
 
-    for (MTMidiMsg* msg : msgs)
+    for (const MTMidiEvent &event : events)
     {
-        data_length += msg->length_in_bytes(current_tick);
+        data_length += MTMidiFileStream::length_as_variable_length(event.tick - current_tick);
+        data_length += event.length;
+        current_tick = event.tick;
     }
 
     return data_length;
 }
 
-void MTMidiTrack::update_meta_data()
+/// @brief Encodes messages as track chunk data, with tick deltas and
+/// without running status.  Only reads the events, so it can run on a
+/// worker thread on a snapshot of the messages.
+/// @param events MTMidiEventList, messages in tick order
+/// @param data Pointer receiving measure_events() bytes
+void MTMidiTrack::encode_events(const MTMidiEventList &events, uint8_t *data)
 {
-    max_note_value = -1;
-    min_note_value = 128;
-    channels_used.clear();
-    channels_with_notes.clear();
-    note_values.clear();
-    track_type = TrackType::Unknown;
+    uint8_t *ptr = data;
+    uint64_t current_tick = 0;
 
-    for (MTMidiMsg* msg : msgs)
+    for (const MTMidiEvent &event : events)
     {
-        int32_t type = msg->get_channel_msg_type();
-        switch(type)
+        ptr += MTMidiMsg::store_variable_length(event.tick - current_tick, ptr);
+        memcpy(ptr, event.bytes, event.length);
+        ptr += event.length;
+        current_tick = event.tick;
+    }
+}
+
+/// @brief Appends a message to the track, updating the metadata and the
+/// note spans
+/// @param event MTMidiEvent to append, its bytes must outlive the track
+void MTMidiTrack::append_event(const MTMidiEvent &event)
+{
+    events.push_back(event);
+    add_meta_data(event);
+    if (!note_spans_dirty)
+    {
+        add_note_span(event, events.size() - 1);
+    }
+}
+
+/// @brief Appends a copy of a message to the track
+/// The message bytes are copied into the arena, the caller keeps ownership
+/// of the message.
+/// @param msg Pointer to the MTMidiMsg to append
+void MTMidiTrack::append_msg(const MTMidiMsg *msg)
+{
+    MTMidiEvent event;
+    event.tick = msg->tick;
+    event.length = msg->msg_bytes.size();
+    event.bytes = arena->store(msg->msg_bytes.ptr(), event.length);
+    event.data_length = msg->data_length;
+    event.data_start = msg->data_start;
+    event.channel_prefix = msg->channel_prefix;
+    event.port_prefix = msg->port_prefix;
+    append_event(event);
+}
+
+/// @brief Finds where a message at a tick is inserted: after the messages
+/// with the same tick, but always before the End of Track message that ends
+/// the track
+/// @param tick uint64_t, tick of the message
+/// @return int64_t, index the message gets
+int64_t MTMidiTrack::find_insert_index(uint64_t tick) const
+{
+    int64_t low = 0;
+    int64_t high = events.size();
+    while (low < high)
+    {
+        int64_t mid = (low + high) / 2;
+        if (events[mid].tick <= tick)
         {
-            case MTMidiMsg::ChannelMsgType::NonChannel:
-                if (track_type == TrackType::Unknown)
-                {
-                    track_type = TrackType::Meta;
-                }
-                break;
-            default:
-                uint8_t ch = msg->get_channel();
-                channels_used.insert(ch);
-                track_type = ch == 9 ? TrackType::Drum : TrackType::Note;
-                if (type == MTMidiMsg::ChannelMsgType::NoteOn || type == MTMidiMsg::ChannelMsgType::NoteOff)
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if ((low == events.size()) && ends_with_end_of_track())
+    {
+        --low;
+    }
+    return low;
+}
+
+/// @brief Finds the channel and port prefixes in effect before a message,
+/// as init_event() would have them when reading the track
+/// Sysex messages do not record the channel prefix, so the search goes back
+/// to the last channel or meta message.
+/// @param index int64_t, index of the message
+/// @param channel_prefix uint8_t, receives the channel prefix
+/// @param port_prefix uint8_t, receives the port prefix
+void MTMidiTrack::get_prefixes_at(int64_t index, uint8_t &channel_prefix, uint8_t &port_prefix) const
+{
+    channel_prefix = 0;
+    port_prefix = 0;
+    bool port_found = false;
+    for (int64_t i = MIN(index, events.size()) - 1; i >= 0; --i)
+    {
+        const MTMidiEvent &event = events[i];
+        if (!port_found)
+        {
+            port_prefix = event.port_prefix;
+            port_found = true;
+        }
+        if (event.is_channel_msg())
+        {
+            channel_prefix = event.bytes[0] & 0x0F;
+            return;
+        }
+        if (event.bytes[0] == 0xFF)
+        {
+            channel_prefix = event.channel_prefix;
+            return;
+        }
+    }
+}
+
+/// @brief Inserts a message in tick order, after the messages with the same
+/// tick, updating the metadata
+/// The End of Track message stays last, and moves to the tick of a message
+/// inserted after it.  Only the chunk of events receiving the message is
+/// copied when the events are shared with a snapshot.
+/// @param event MTMidiEvent to insert, its bytes must outlive the track
+/// @return int64_t, index of the inserted message, -1 for an End of Track
+///         message
+int64_t MTMidiTrack::insert_event(const MTMidiEvent &event)
+{
+    if (event.is_meta_msg(MTMidiMsg::MetaMsgType::EndOfTrack))
+    {
+        return -1;
+    }
+
+    int64_t index = find_insert_index(event.tick);
+    contains_unsaved_edits = true;
+    if (index == events.size())
+    {
+        append_event(event);
+        return index;
+    }
+
+    events.insert(index, event);
+    add_meta_data(event);
+    // Span indices after the message shift, rebuilt when next requested
+    note_spans_dirty = true;
+    if (index == events.size() - 2)
+    {
+        update_end_of_track(MAX(event.tick, events.get_last().tick));
+    }
+    return index;
+}
+
+/// @brief Updates the End of Track message ending the track after the
+/// message before it changed: its tick and the prefixes in effect.
+/// @param tick uint64_t, new tick of the message
+void MTMidiTrack::update_end_of_track(uint64_t tick)
+{
+    MTMidiEvent end_of_track = events.get_last();
+    end_of_track.tick = tick;
+    get_prefixes_at(events.size() - 1, end_of_track.channel_prefix, end_of_track.port_prefix);
+    events.remove_at(events.size() - 1);
+    events.push_back(end_of_track);
+}
+
+/// @brief Removes a message from the track, updating the metadata
+/// Its bytes stay in the arena until the file is cleared.  The End of Track
+/// message that ends the track can not be removed.
+/// @param index int64_t, index of the message
+/// @return bool, false if the index is out of range or the final End of Track
+bool MTMidiTrack::remove_event(int64_t index)
+{
+    if ((index < 0) || (index >= events.size()) ||
+        ((index == events.size() - 1) && ends_with_end_of_track()))
+    {
+        return false;
+    }
+    remove_meta_data(events[index]);
+    events.remove_at(index);
+    contains_unsaved_edits = true;
+    // Span indices after the message shift, rebuilt when next requested
+    note_spans_dirty = true;
+    if ((index == events.size() - 1) && ends_with_end_of_track())
+    {
+        update_end_of_track(events.get_last().tick);
+    }
+    return true;
+}
+
+/// @brief Creates a message object for one of the track's messages
+/// Every message object gets its own id, see MTMidiMsg::get_id().
+/// @param index int64_t, index of the message
+/// @return Pointer to a new MTMidiMsg owned by the caller, nullptr if the
+///         index is out of range
+MTMidiMsg *MTMidiTrack::create_msg(int64_t index) const
+{
+    if ((index < 0) || (index >= events.size()))
+    {
+        return nullptr;
+    }
+    return MTMidiMsg::create_from_event(events[index]);
+}
+
+/// @brief Adds a message to the track metadata
+/// Called for every message appended, so reading a track needs no extra pass.
+/// @param event MTMidiEvent added to the track
+void MTMidiTrack::add_meta_data(const MTMidiEvent &event)
+{
+    if (event.length == 0)
+    {
+        return;
+    }
+
+    const uint8_t *data = event.bytes;
+    if ((data[0] < 0x80) || (data[0] >= 0xF0))
+    {
+        ++non_channel_msg_count;
+        return;
+    }
+
+    uint8_t ch = data[0] & 0x0F;
+    if (channel_msg_counts[ch]++ == 0)
+    {
+        channels_used |= 1 << ch;
+    }
+
+    // Note On or Note Off
+    if (((data[0] & 0xE0) == 0x80) && (event.length > 1))
+    {
+        uint8_t note = data[1] & 0x7F;
+        if (channel_note_counts[ch]++ == 0)
+        {
+            channels_with_notes |= 1 << ch;
+        }
+        if (note_histogram[note]++ == 0)
+        {
+            note_mask[note >> 6] |= 1ULL << (note & 0x3F);
+            min_note_value = note < min_note_value ? note : min_note_value;
+            max_note_value = note > max_note_value ? note : max_note_value;
+        }
+    }
+}
+
+/// @brief Removes a message from the track metadata
+/// @param event MTMidiEvent removed from the track
+void MTMidiTrack::remove_meta_data(const MTMidiEvent &event)
+{
+    if (event.length == 0)
+    {
+        return;
+    }
+
+    const uint8_t *data = event.bytes;
+    if ((data[0] < 0x80) || (data[0] >= 0xF0))
+    {
+        --non_channel_msg_count;
+        return;
+    }
+
+    uint8_t ch = data[0] & 0x0F;
+    if (--channel_msg_counts[ch] == 0)
+    {
+        channels_used &= ~(1 << ch);
+    }
+
+    if (((data[0] & 0xE0) == 0x80) && (event.length > 1))
+    {
+        uint8_t note = data[1] & 0x7F;
+        if (--channel_note_counts[ch] == 0)
+        {
+            channels_with_notes &= ~(1 << ch);
+        }
+        if (--note_histogram[note] == 0)
+        {
+            note_mask[note >> 6] &= ~(1ULL << (note & 0x3F));
+            if ((note == min_note_value) || (note == max_note_value))
+            {
+                // Find the new note range from the remaining note values
+                min_note_value = 128;
+                max_note_value = -1;
+                for (int32_t val = 0; val < 128; ++val)
                 {
-                    uint8_t noteVal = msg->get_note_value();
-                    min_note_value = noteVal < min_note_value ? noteVal : min_note_value;
-                    max_note_value = noteVal > max_note_value ? noteVal : max_note_value;
-                    note_values.insert(noteVal);
-                    channels_with_notes.insert(ch);
+                    if (uses_note(val))
+                    {
+                        min_note_value = val < min_note_value ? val : min_note_value;
+                        max_note_value = val;
+                    }
                 }
-                break;
+            }
         }
     }
 }
 
+void MTMidiTrack::clear_meta_data()
+{
+    max_note_value = -1;
+    min_note_value = 128;
+    channels_used = 0;
+    channels_with_notes = 0;
+    note_mask[0] = 0;
+    note_mask[1] = 0;
+    memset(note_histogram, 0, sizeof(note_histogram));
+    memset(channel_msg_counts, 0, sizeof(channel_msg_counts));
+    memset(channel_note_counts, 0, sizeof(channel_note_counts));
+    non_channel_msg_count = 0;
+}
+
+/// @brief Rebuilds the metadata from all messages
+/// Only needed when messages are changed in place.
+void MTMidiTrack::update_meta_data()
+{
+    clear_meta_data();
+    for (const MTMidiEvent &event : events)
+    {
+        add_meta_data(event);
+    }
+    rebuild_note_spans();
+}
+
+/// @brief Returns the track type from the metadata
+/// Drum tracks only contain channel messages on channel 10 (index 9),
+/// Meta tracks contain no channel messages.
+/// @return TrackType
+MTMidiTrack::TrackType MTMidiTrack::get_track_type() const
+{
+    if (channels_used == 0)
+    {
+        return non_channel_msg_count > 0 ? TrackType::Meta : TrackType::Unknown;
+    }
+    return channels_used == (1 << 9) ? TrackType::Drum : TrackType::Note;
+}
+
 PackedByteArray MTMidiTrack::get_note_values()
 {
     PackedByteArray vals;
-    if (note_values.size() > 0)
+    for (int32_t val = 0; val < 128; ++val)
     {
-        for (uint8_t val : note_values)
+        if (uses_note(val))
         {
             vals.append(val);
         }
     }
     return vals;
 }
+
+/// @brief Matches a Note On or Note Off message with the open note spans
+/// A Note On opens a span, a Note On with velocity 0 or a Note Off closes
+/// the oldest open span with the same channel and key, so overlapping notes
+/// on the same key end in the order they started.  A Note Off without an
+/// open span is ignored.
+/// @param event MTMidiEvent appended to the track
+/// @param index int32_t, index of the message in the track
+void MTMidiTrack::add_note_span(const MTMidiEvent &event, int32_t index)
+{
+    const uint8_t *data = event.bytes;
+    if ((event.length < 3) || ((data[0] & 0xE0) != 0x80))
+    {
+        return;
+    }
+
+    if (open_first.is_empty())
+    {
+        open_first.resize(16 * 128);
+        open_last.resize(16 * 128);
+        open_first.fill(-1);
+        open_last.fill(-1);
+    }
+
+    uint8_t channel = data[0] & 0x0F;
+    uint8_t key = data[1] & 0x7F;
+    uint8_t velocity = data[2] & 0x7F;
+    int32_t slot = (channel << 7) | key;
+
+    if (((data[0] & 0xF0) == MTMidiMsg::ChannelMsgType::NoteOn) && (velocity > 0))
+    {
+        NoteSpan span;
+        span.start_tick = event.tick;
+        span.end_tick = event.tick;
+        span.start_index = index;
+        span.end_index = -1;
+        span.channel = channel;
+        span.key = key;
+        span.velocity = velocity;
+        span.release_velocity = 0;
+
+        int32_t span_index = note_spans.size();
+        note_spans.push_back(span);
+        open_next.push_back(-1);
+        if (open_last[slot] >= 0)
+        {
+            open_next.write[open_last[slot]] = span_index;
+        }
+        else
+        {
+            open_first.write[slot] = span_index;
+        }
+        open_last.write[slot] = span_index;
+        ++open_note_count;
+        return;
+    }
+
+    int32_t span_index = open_first[slot];
+    if (span_index < 0)
+    {
+        return;
+    }
+
+    NoteSpan &span = note_spans.write[span_index];
+    span.end_tick = event.tick;
+    span.end_index = index;
+    span.release_velocity = (data[0] & 0xF0) == MTMidiMsg::ChannelMsgType::NoteOff ? velocity : 0;
+
+    open_first.write[slot] = open_next[span_index];
+    if (open_first[slot] < 0)
+    {
+        open_last.write[slot] = -1;
+    }
+    --open_note_count;
+}
+
+/// @brief Rebuilds the note spans from all messages
+void MTMidiTrack::rebuild_note_spans()
+{
+    note_spans.clear();
+    open_next.clear();
+    open_first.clear();
+    open_last.clear();
+    open_note_count = 0;
+    note_spans_dirty = false;
+
+    for (int32_t index = 0; index < events.size(); ++index)
+    {
+        add_note_span(events[index], index);
+    }
+}
+
+/// @brief Returns the matched Note On/Off pairs of the track
+/// Spans are in Note On order.  Notes still open at the end of the track
+/// end at the tick of the last message and have an end_index of -1.
+/// @return Vector of NoteSpan, valid until the track is changed
+const Vector<MTMidiTrack::NoteSpan> &MTMidiTrack::get_note_spans()
+{
+    if (note_spans_dirty)
+    {
+        rebuild_note_spans();
+    }
+
+    if ((open_note_count > 0) && !events.is_empty())
+    {
+        uint64_t last_tick = events.get_last().tick;
+        for (int32_t slot = 0; slot < open_first.size(); ++slot)
+        {
+            for (int32_t span_index = open_first[slot]; span_index >= 0; span_index = open_next[span_index])
+            {
+                note_spans.write[span_index].end_tick = last_tick;
+            }
+        }
+    }
+    return note_spans;
+}
+
+/// @brief Returns the number of notes without a Note Off so far
+/// @return int32_t
+int32_t MTMidiTrack::get_open_note_count()
+{
+    if (note_spans_dirty)
+    {
+        rebuild_note_spans();
+    }
+    return open_note_count;
+}
+
+/// @brief Takes a snapshot of the messages
+/// O(1): the events are shared until the track or the snapshot changes,
+/// and edits after that copy only the chunks they touch.  The message bytes
+/// stay valid as long as the arena is not cleared.
+/// @param snapshot Snapshot receiving the state
+void MTMidiTrack::create_snapshot(Snapshot &snapshot) const
+{
+    snapshot.events = events;
+    snapshot.contains_unsaved_edits = contains_unsaved_edits;
+}
+
+/// @brief Returns the track to the messages of a snapshot
+/// Nothing is done when the track has not changed since the snapshot,
+/// otherwise the metadata is rebuilt and the note spans are rebuilt when
+/// next requested.
+/// @param snapshot Snapshot taken by create_snapshot() on a track using the same arena
+void MTMidiTrack::restore_snapshot(const Snapshot &snapshot)
+{
+    contains_unsaved_edits = snapshot.contains_unsaved_edits;
+    if (events.shares_storage(snapshot.events))
+    {
+        return;
+    }
+    events = snapshot.events;
+    clear_meta_data();
+    for (const MTMidiEvent &event : events)
+    {
+        add_meta_data(event);
+    }
+    note_spans_dirty = true;
+}
@@ -1,40 +1,119 @@
 #ifndef MT_MIDI_TRACK_H
 #define MT_MIDI_TRACK_H
 
-#include <godot_cpp/templates/hash_set.hpp>
+#include <godot_cpp/templates/vector.hpp>
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+#include "mt_midi_arena.hpp"
+#include "mt_midi_event_list.hpp"
 #include "mt_midi_msg.hpp"
 #include "mt_midi_file_stream.hpp"
+#include "mt_smf_file.hpp"
 
 
 namespace godot {
 
 class MTMidiTrack : public Object {
 
+public:
+    // A Note On matched with its Note Off
+    struct NoteSpan {
+        uint64_t start_tick;
+        uint64_t end_tick;          // Tick of the last message while the note is open
+        int32_t start_index;        // Index of the Note On message
+        int32_t end_index;          // Index of the Note Off message, -1 while open
+        uint8_t channel;
+        uint8_t key;
+        uint8_t velocity;
+        uint8_t release_velocity;   // Note Off velocity, 0 for Note On velocity 0
+    };
+
+    // Messages of a track at one point of editing, shared with the track
+    // until either is changed, see create_snapshot()
+    struct Snapshot {
+        MTMidiEventList events;
+        bool contains_unsaved_edits;
+    };
+
 private:
-    List<MTMidiMsg*> msgs;
+    // Messages in tick order, their bytes are owned by 'arena'
+    MTMidiEventList events;
+    MTMidiArena *arena;
+
+    // Note spans in Note On order, built as messages are appended
+    Vector<NoteSpan> note_spans;
+    // Open spans per channel and key, oldest first, linked through open_next
+    Vector<int32_t> open_first;
+    Vector<int32_t> open_last;
+    Vector<int32_t> open_next;
+    int32_t open_note_count = 0;
+    bool note_spans_dirty = false;
+
+    // Track chunk data as last encoded, with the messages it holds.  Valid
+    // while 'events' shares its storage with 'chunk_events', so any edit
+    // invalidates it, see get_chunk_data().
+    MTMidiEventList chunk_events;
+    PackedByteArray chunk_data;
+
+    void add_note_span(const MTMidiEvent &event, int32_t index);
+    void rebuild_note_spans();
+    void update_end_of_track(uint64_t tick);
+
 public:
     enum TrackType { Unknown = 0, Note = 1, Drum = 2, Meta = 3 };
 	int32_t track_id;
 	int32_t max_note_value = -1;
 	int32_t min_note_value = 128;
 	bool contains_unsaved_edits = false;
-	HashSet<uint8_t> channels_used;
-	HashSet<uint8_t> channels_with_notes;
-	HashSet<uint8_t> note_values;
-	TrackType track_type = TrackType::Unknown;
-
-	List<MTMidiMsg*> TrackMsgs() { return msgs;}
-    void TrackMsgs(List<MTMidiMsg*> value) { msgs = value; }
-
-	MTMidiTrack(uint64_t id) : track_id(id) {}
-    ~MTMidiTrack();
-    static MTMidiTrack* read_track(MTMidiFileStream file_stream, int track_id, Error& result);
-    Error write_events_to_stream(MTMidiFileStream file_stream);
+
+	// Metadata, maintained as messages are appended and removed
+	uint16_t channels_used = 0;             // Bit per channel with channel messages
+	uint16_t channels_with_notes = 0;       // Bit per channel with Note On/Off messages
+	uint64_t note_mask[2] = { 0, 0 };       // Bit per note value used
+	uint32_t note_histogram[128] = {};      // Note On/Off message count per note value
+	uint32_t channel_msg_counts[16] = {};
+	uint32_t channel_note_counts[16] = {};
+	uint32_t non_channel_msg_count = 0;
+
+	MTMidiTrack(uint64_t id, MTMidiArena *arena) : arena(arena), track_id(id) {}
+    MTMidiArena *get_arena() const { return arena; }
+    int64_t get_event_count() const { return events.size(); }
+    const MTMidiEvent &get_event(int64_t index) const { return events[index]; }
+    const MTMidiEventList &get_events() const { return events; }
+    void append_event(const MTMidiEvent &event);
+    void append_msg(const MTMidiMsg *msg);
+    bool ends_with_end_of_track() const { return !events.is_empty() && events.get_last().is_meta_msg(MTMidiMsg::MetaMsgType::EndOfTrack); }
+    int64_t find_insert_index(uint64_t tick) const;
+    void get_prefixes_at(int64_t index, uint8_t &channel_prefix, uint8_t &port_prefix) const;
+    int64_t insert_event(const MTMidiEvent &event);
+    bool remove_event(int64_t index);
+    void create_snapshot(Snapshot &snapshot) const;
+    void restore_snapshot(const Snapshot &snapshot);
+    MTMidiMsg *create_msg(int64_t index) const;
+    static MTMidiTrack* read_track(MTMidiFileStream &file_stream, int track_id, MTMidiArena *arena, Error& result,
+                                   const mtcore::SmfLimits &limits = mtcore::SmfLimits(), uint64_t max_events = UINT64_MAX);
+    static MTMidiTrack* build_track(int track_id, MTMidiArena *arena, const PackedInt64Array &ticks,
+                                    const PackedByteArray &statuses, const PackedInt32Array &offsets,
+                                    const PackedByteArray &data, Error& result);
+    Error write_events_to_stream(MTMidiFileStream &file_stream);
+    PackedByteArray get_chunk_data();
+    bool get_cached_chunk_data(PackedByteArray &data) const;
+    void cache_chunk_data(const MTMidiEventList &encoded_events, const PackedByteArray &data);
     int32_t get_length_in_bytes();
+    static uint64_t measure_events(const MTMidiEventList &events);
+    static void encode_events(const MTMidiEventList &events, uint8_t *data);
+    void add_meta_data(const MTMidiEvent &event);
+    void remove_meta_data(const MTMidiEvent &event);
+    void clear_meta_data();
     void update_meta_data();
+    TrackType get_track_type() const;
+    bool uses_channel(uint8_t channel) const { return (channels_used >> (channel & 0x0F)) & 1; }
+    bool uses_note(uint8_t note) const { return (note_mask[(note >> 6) & 1] >> (note & 0x3F)) & 1; }
     PackedByteArray get_note_values();
+    const Vector<NoteSpan> &get_note_spans();
+    int32_t get_open_note_count();
 };
 }
 #endif
@@ -0,0 +1,84 @@
+#include "mt_midi_track_merger.hpp"
+
+using namespace godot;
+
+static inline bool merges_before(uint64_t tick_a, int32_t slot_a, uint64_t tick_b, int32_t slot_b)
+{
+    return (tick_a < tick_b) || ((tick_a == tick_b) && (slot_a < slot_b));
+}
+
+/// @brief Starts a merge of all tracks of a file
+/// @param tracks Tracks of the file, merged in map order
+MTMidiTrackMerger::MTMidiTrackMerger(const HashMap<uint32_t, MTMidiTrack*> &tracks)
+{
+    int32_t track_slot = 0;
+    for (const KeyValue<uint32_t, MTMidiTrack*> &element : tracks)
+    {
+        const MTMidiEventList &events = element.value->get_events();
+        track_ids.push_back(element.key);
+        if (!events.is_empty())
+        {
+            heap.push_back({ events.begin(), events.size(), (*events.begin()).tick, track_slot });
+            event_count += events.size();
+            end_tick = MAX(end_tick, events.get_last().tick);
+        }
+        ++track_slot;
+    }
+
+    for (int32_t index = heap.size() / 2 - 1; index >= 0; --index)
+    {
+        sift_down(index);
+    }
+}
+
+void MTMidiTrackMerger::sift_down(int32_t index)
+{
+    Cursor *cursors = heap.ptrw();
+    int32_t size = heap.size();
+    while (true)
+    {
+        int32_t first = index;
+        int32_t left = index * 2 + 1;
+        int32_t right = left + 1;
+        if ((left < size) && merges_before(cursors[left].tick, cursors[left].slot, cursors[first].tick, cursors[first].slot))
+        {
+            first = left;
+        }
+        if ((right < size) && merges_before(cursors[right].tick, cursors[right].slot, cursors[first].tick, cursors[first].slot))
+        {
+            first = right;
+        }
+        if (first == index)
+        {
+            return;
+        }
+        SWAP(cursors[index], cursors[first]);
+        index = first;
+    }
+}
+
+/// @brief Steps to the next message of the merge
+/// @return Pointer to the MTMidiEvent, nullptr when all tracks are done
+const MTMidiEvent *MTMidiTrackMerger::next()
+{
+    if (heap.is_empty())
+    {
+        return nullptr;
+    }
+
+    Cursor *cursor = heap.ptrw();
+    const MTMidiEvent *event = &*cursor->next;
+    slot = cursor->slot;
+    if (--cursor->remaining > 0)
+    {
+        ++cursor->next;
+        cursor->tick = (*cursor->next).tick;
+    }
+    else
+    {
+        cursor[0] = cursor[heap.size() - 1];
+        heap.resize(heap.size() - 1);
+    }
+    sift_down(0);
+    return event;
+}
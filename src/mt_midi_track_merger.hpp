@@ -0,0 +1,43 @@
+#ifndef MT_MIDI_TRACK_MERGER_H
+#define MT_MIDI_TRACK_MERGER_H
+
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/vector.hpp>
+#include "mt_midi_track.hpp"
+
+namespace godot {
+
+// Visits the messages of several tracks in tick order, messages with the
+// same tick in track order.  The tracks are kept in a binary heap keyed by
+// their next message, so a merge of n messages in k tracks is O(n log k);
+// with one track it is a plain copy.  The tracks must not change while they
+// are merged.
+class MTMidiTrackMerger {
+    private:
+    struct Cursor {
+        MTMidiEventList::ConstIterator next;
+        int64_t remaining;
+        uint64_t tick;
+        int32_t slot;               // Track order, breaks ties between equal ticks
+    };
+
+    Vector<Cursor> heap;
+    Vector<uint32_t> track_ids;
+    int32_t slot = -1;
+    int64_t event_count = 0;
+    uint64_t end_tick = 0;
+
+    void sift_down(int32_t index);
+
+    public:
+    explicit MTMidiTrackMerger(const HashMap<uint32_t, MTMidiTrack*> &tracks);
+
+    const MTMidiEvent *next();
+    // Track of the message last returned by next(), numbered in map order
+    int32_t get_slot() const { return slot; }
+    uint32_t get_track_id() const { return track_ids[slot]; }
+    int64_t get_event_count() const { return event_count; }
+    uint64_t get_end_tick() const { return end_tick; }
+};
+}
+#endif
@@ -1,16 +1,38 @@
 #include "register_types.h"
 
 #include "mt_fluid_synth_node.hpp"
+#include "mt_midi_cache.hpp"
 #include "mt_midi_file.hpp"
+#include "mt_midi_import_plugin.hpp"
+#include "mt_midi_library_index.hpp"
 #include "mt_midi_msg.hpp"
+#include "mt_midi_stream_parser.hpp"
+#ifdef MT_BENCHMARKS
+#include "mt_midi_benchmark.hpp"
+#include "mt_synth_benchmark.hpp"
+#endif
 
 #include <gdextension_interface.h>
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/godot.hpp>
+#include <godot_cpp/classes/editor_plugin_registration.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
+#include <godot_cpp/classes/resource_saver.hpp>
 
 using namespace godot;
 
+static Ref<MTMidiCacheFormatLoader> cache_loader;
+static Ref<MTMidiCacheFormatSaver> cache_saver;
+static Ref<MTMidiFileFormatLoader> midi_loader;
+
 void initialize_miditools_module(ModuleInitializationLevel p_level) {
+	if (p_level == MODULE_INITIALIZATION_LEVEL_EDITOR) {
+		GDREGISTER_CLASS(MTMidiImportPlugin);
+		GDREGISTER_CLASS(MTMidiEditorPlugin);
+		EditorPlugins::add_by_type<MTMidiEditorPlugin>();
+		return;
+	}
+
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
@@ -41,12 +63,51 @@ void initialize_miditools_module(ModuleInitializationLevel p_level) {
 	GDREGISTER_CLASS(MTMidiFile);
 	GDREGISTER_CLASS(MTMidiMsgList);
 	GDREGISTER_CLASS(MTMidiMsg);
+
+	GDREGISTER_CLASS(MTMidiLibraryIndex);
+
+	GDREGISTER_CLASS(MTMidiStreamParser);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_IDLE", MTMidiStreamParser::Idle);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_FILE_HEADER", MTMidiStreamParser::FileHeader);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_CHUNK_HEADER", MTMidiStreamParser::ChunkHeader);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_TRACK_DATA", MTMidiStreamParser::TrackData);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_SKIP_CHUNK", MTMidiStreamParser::SkipChunk);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_COMPLETE", MTMidiStreamParser::Complete);
+    ClassDB::bind_integer_constant("MTMidiStreamParser", "", "STATE_FAILED", MTMidiStreamParser::Failed);
+
+	GDREGISTER_CLASS(MTMidiCacheFormatLoader);
+	GDREGISTER_CLASS(MTMidiCacheFormatSaver);
+	cache_loader.instantiate();
+	ResourceLoader::get_singleton()->add_resource_format_loader(cache_loader);
+	cache_saver.instantiate();
+	ResourceSaver::get_singleton()->add_resource_format_saver(cache_saver);
+
+	GDREGISTER_CLASS(MTMidiFileFormatLoader);
+	midi_loader.instantiate();
+	ResourceLoader::get_singleton()->add_resource_format_loader(midi_loader);
+
+#ifdef MT_BENCHMARKS
+	GDREGISTER_CLASS(MTMidiBenchmark);
+	GDREGISTER_CLASS(MTSynthBenchmark);
+#endif
 }
 
 void uninitialize_miditools_module(ModuleInitializationLevel p_level) {
+	if (p_level == MODULE_INITIALIZATION_LEVEL_EDITOR) {
+		EditorPlugins::remove_by_type<MTMidiEditorPlugin>();
+		return;
+	}
+
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+
+	ResourceLoader::get_singleton()->remove_resource_format_loader(cache_loader);
+	cache_loader.unref();
+	ResourceSaver::get_singleton()->remove_resource_format_saver(cache_saver);
+	cache_saver.unref();
+	ResourceLoader::get_singleton()->remove_resource_format_loader(midi_loader);
+	midi_loader.unref();
 }
 
 extern "C" {
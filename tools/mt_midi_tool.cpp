@@ -0,0 +1,542 @@
+// Command-line batch tool for MIDI files, built with 'scons tool'.  Uses the
+// core SMF code and FluidSynth directly, so no Godot instance is needed.
+//
+//   miditools render --soundfont <sf2> [options] <files...>
+//   miditools resave [options] <files...>
+//   miditools info [options] <files...>
+//
+// Run without arguments for the list of options.
+
+#include "mt_smf_file.hpp"
+#include <fluidsynth.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mtcore;
+
+namespace {
+
+const char *USAGE =
+    "Usage: miditools <command> [options] <files...>\n"
+    "\n"
+    "Commands:\n"
+    "  render    render MIDI files to audio with FluidSynth\n"
+    "  resave    re-save MIDI files normalized: explicit status bytes, one\n"
+    "            End of Track per track, other chunks dropped\n"
+    "  info      print the metadata of MIDI files, one JSON object per line\n"
+    "\n"
+    "Options:\n"
+    "  -o, --output <dir>       directory for output files, default next to the input\n"
+    "  -j <n>                   number of files processed in parallel, default 1\n"
+    "  --overwrite              replace existing output files, resave in place\n"
+    "  --strict                 reject files over the strict parsing limits, for\n"
+    "                           untrusted input\n"
+    "  --soundfont <path>       SoundFont used by render, required\n"
+    "  --type <type>            audio file type of render: wav, flac, oga, raw, default wav\n"
+    "  --sample-rate <hz>       sample rate of render, 8000 to 96000, default 44100\n"
+    "  --bit-depth <format>     sample format of render: s16, s24, s32, float, default s16\n"
+    "  --interpolation <n>      0 none, 1 linear, 2 4th order, 3 7th order, default 2\n";
+
+enum class Command { Render, Resave, Info };
+
+struct Options {
+    Command command = Command::Info;
+    std::vector<std::string> files;
+    std::string output_dir;
+    int32_t jobs = 1;
+    bool overwrite = false;
+    SmfLimits limits;
+    std::string soundfont;
+    std::string type = "wav";
+    double sample_rate = 44100.0;
+    std::string bit_depth = "s16";
+    int32_t interpolation = 2;
+};
+
+// Outcome of one file, printed in input order once all jobs are done
+struct Job {
+    std::string output;
+    std::string error;
+};
+
+bool file_exists(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+    return file != nullptr;
+}
+
+/// @brief Builds the path of an output file
+/// @param options Options, giving the output directory
+/// @param input std::string, path of the input file
+/// @param extension std::string, extension of the output file, without dot
+/// @return std::string, path in the output directory, or next to the input
+std::string get_output_path(const Options &options, const std::string &input, const std::string &extension)
+{
+    size_t slash = input.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? std::string() : input.substr(0, slash + 1);
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos)
+    {
+        name = name.substr(0, dot);
+    }
+    if (!options.output_dir.empty())
+    {
+        dir = options.output_dir;
+        if ((dir.back() != '/') && (dir.back() != '\\'))
+        {
+            dir += '/';
+        }
+    }
+    return dir + name + "." + extension;
+}
+
+std::string json_string(const std::string &value)
+{
+    std::string result = "\"";
+    for (unsigned char c : value)
+    {
+        if ((c == '"') || (c == '\\'))
+        {
+            result += '\\';
+            result += c;
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            result += escaped;
+        }
+        else
+        {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+fluid_interp get_interp_method(int32_t method)
+{
+    switch (method)
+    {
+        case 0: return FLUID_INTERP_NONE;
+        case 1: return FLUID_INTERP_LINEAR;
+        case 2: return FLUID_INTERP_4THORDER;
+        case 3: return FLUID_INTERP_7THORDER;
+    }
+    return FLUID_INTERP_DEFAULT;
+}
+
+/// @brief Renders a file with FluidSynth, like MTFluidSynthNode::synth_render_file()
+/// The file is checked and normalized by the core reader first, the player
+/// gets the result from memory.
+void render(const Options &options, const std::string &input, Job &job)
+{
+    SmfFile smf;
+    SmfResult result = smf.load(input, options.limits);
+    std::vector<uint8_t> contents;
+    if ((result != SmfResult::Ok) || ((result = smf.write(contents)) != SmfResult::Ok))
+    {
+        job.error = get_result_text(result);
+        return;
+    }
+
+    std::string output = get_output_path(options, input, options.type);
+    if (!options.overwrite && file_exists(output))
+    {
+        job.error = "output exists: " + output;
+        return;
+    }
+
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_setstr(settings, "audio.file.name", output.c_str());
+    fluid_settings_setstr(settings, "audio.file.type", options.type.c_str());
+    fluid_settings_setstr(settings, "audio.file.format", options.bit_depth.c_str());
+    fluid_settings_setstr(settings, "player.timing-source", "sample");
+    fluid_settings_setint(settings, "synth.lock-memory", 0);
+    fluid_settings_setnum(settings, "synth.sample-rate", options.sample_rate);
+
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    fluid_player_t *player = nullptr;
+    fluid_file_renderer_t *renderer = nullptr;
+    if (synth == nullptr)
+    {
+        job.error = "failed to create FluidSynth";
+    }
+    else if (fluid_synth_sfload(synth, options.soundfont.c_str(), 1) == FLUID_FAILED)
+    {
+        job.error = "failed to load SoundFont: " + options.soundfont;
+    }
+    else if (fluid_synth_set_interp_method(synth, -1, get_interp_method(options.interpolation)) == FLUID_FAILED)
+    {
+        job.error = "failed to set interpolation method";
+    }
+    else if (((player = new_fluid_player(synth)) == nullptr) ||
+             (fluid_player_add_mem(player, contents.data(), contents.size()) == FLUID_FAILED))
+    {
+        job.error = "failed to load the MIDI data";
+    }
+    else if ((renderer = new_fluid_file_renderer(synth)) == nullptr)
+    {
+        job.error = "failed to create audio file: " + output;
+    }
+    else
+    {
+        fluid_player_play(player);
+        while (fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+        {
+            if (fluid_file_renderer_process_block(renderer) != FLUID_OK)
+            {
+                job.error = "failed to write audio file: " + output;
+                break;
+            }
+        }
+        fluid_player_stop(player);
+        fluid_player_join(player);
+        if (job.error.empty())
+        {
+            job.output = output;
+        }
+    }
+
+    if (renderer != nullptr)
+    {
+        delete_fluid_file_renderer(renderer);
+    }
+    if (player != nullptr)
+    {
+        delete_fluid_player(player);
+    }
+    if (synth != nullptr)
+    {
+        delete_fluid_synth(synth);
+    }
+    delete_fluid_settings(settings);
+}
+
+/// @brief Re-saves a file with explicit status bytes and exactly one End of
+/// Track message, at the end of every track
+void resave(const Options &options, const std::string &input, Job &job)
+{
+    SmfFile smf;
+    SmfResult result = smf.load(input, options.limits);
+    if (result != SmfResult::Ok)
+    {
+        job.error = get_result_text(result);
+        return;
+    }
+
+    for (SmfTrack &track : smf.tracks)
+    {
+        uint64_t last_tick = track.events.empty() ? 0 : track.events.back().tick;
+        track.events.erase(std::remove_if(track.events.begin(), track.events.end(),
+            [](const SmfEvent &event) { return event.is_meta_msg(META_END_OF_TRACK); }), track.events.end());
+        const uint8_t end_of_track = META_END_OF_TRACK;
+        track.append(last_tick, STATUS_META, &end_of_track, 1);
+    }
+
+    std::string output = options.output_dir.empty() ? input : get_output_path(options, input, "mid");
+    if (!options.overwrite && file_exists(output))
+    {
+        job.error = "output exists: " + output;
+        return;
+    }
+    result = smf.save(output);
+    if (result != SmfResult::Ok)
+    {
+        job.error = get_result_text(result);
+        return;
+    }
+    job.output = output;
+}
+
+/// @brief Summarizes a file as one line of JSON
+/// Holds the header values, per track names and event counts, the channels
+/// used, the number of notes and the length in ticks and seconds.
+void info(const Options &options, const std::string &input, Job &job)
+{
+    SmfFile smf;
+    SmfResult result = smf.load(input, options.limits);
+    if ((result != SmfResult::Ok) && smf.tracks.empty())
+    {
+        job.error = get_result_text(result);
+        return;
+    }
+
+    struct Tempo {
+        uint64_t tick;
+        uint32_t usec_per_quarter;
+    };
+    std::vector<Tempo> tempos;
+    uint64_t total_ticks = 0;
+    uint64_t event_count = 0;
+    uint64_t note_count = 0;
+    uint16_t channels = 0;
+    std::string names;
+    std::string track_events;
+    for (const SmfTrack &track : smf.tracks)
+    {
+        std::string name;
+        bool named = false;
+        for (const SmfEvent &event : track.events)
+        {
+            uint8_t status = event.bytes[0];
+            if (status < STATUS_NON_CHANNEL)
+            {
+                channels |= 1 << (status & 0x0F);
+                if (((status & 0xF0) == STATUS_NOTE_ON) && (event.bytes[2] > 0))
+                {
+                    ++note_count;
+                }
+            }
+            else if (event.is_meta_msg(META_SET_TEMPO) && (event.data_length == 3))
+            {
+                const uint8_t *data = event.bytes + event.data_start;
+                tempos.push_back({ event.tick, (uint32_t)((data[0] << 16) | (data[1] << 8) | data[2]) });
+            }
+            else if (event.is_meta_msg(0x03) && !named)
+            {
+                name.assign((const char *)event.bytes + event.data_start, event.data_length);
+                named = true;
+            }
+        }
+        if (!track.events.empty())
+        {
+            total_ticks = std::max(total_ticks, track.events.back().tick);
+        }
+        event_count += track.events.size();
+        names += (names.empty() ? "" : ",") + json_string(name);
+        track_events += (track_events.empty() ? "" : ",") + std::to_string(track.events.size());
+    }
+
+    // Length in seconds, using the tempo changes of all tracks
+    double seconds = 0.0;
+    if (smf.division & 0x8000)
+    {
+        int32_t frames = -(int8_t)(smf.division >> 8);
+        double fps = frames == 29 ? 29.97 : frames;
+        int32_t ticks_per_frame = smf.division & 0xFF;
+        seconds = ((fps > 0.0) && (ticks_per_frame > 0)) ? total_ticks / (fps * ticks_per_frame) : 0.0;
+    }
+    else if (smf.division > 0)
+    {
+        std::stable_sort(tempos.begin(), tempos.end(), [](const Tempo &a, const Tempo &b) { return a.tick < b.tick; });
+        uint64_t tick = 0;
+        uint32_t tempo = 500000;
+        for (const Tempo &change : tempos)
+        {
+            if (change.tick >= total_ticks)
+            {
+                break;
+            }
+            seconds += (change.tick - tick) * (double)tempo / (smf.division * 1000000.0);
+            tick = change.tick;
+            tempo = change.usec_per_quarter;
+        }
+        seconds += (total_ticks - tick) * (double)tempo / (smf.division * 1000000.0);
+    }
+
+    std::string channel_list;
+    for (int32_t i = 0; i < 16; ++i)
+    {
+        if (channels & (1 << i))
+        {
+            channel_list += (channel_list.empty() ? "" : ",") + std::to_string(i + 1);
+        }
+    }
+
+    char numbers[256];
+    snprintf(numbers, sizeof(numbers),
+        "\"format\":%u,\"division\":%u,\"track_count\":%zu,\"event_count\":%llu,\"note_count\":%llu,"
+        "\"total_ticks\":%llu,\"duration\":%.3f",
+        (unsigned)smf.format, (unsigned)smf.division, smf.tracks.size(), (unsigned long long)event_count,
+        (unsigned long long)note_count, (unsigned long long)total_ticks, seconds);
+    job.output = "{\"file\":" + json_string(input) + "," + numbers +
+        ",\"channels\":[" + channel_list + "],\"track_names\":[" + names +
+        "],\"track_events\":[" + track_events + "]" +
+        (result != SmfResult::Ok ? ",\"error\":" + json_string(get_result_text(result)) : std::string()) + "}";
+}
+
+/// @brief Parses the command line
+/// @return bool, false after printing an error
+bool parse_options(int argc, char **argv, Options &options)
+{
+    if (argc < 2)
+    {
+        fputs(USAGE, stderr);
+        return false;
+    }
+
+    std::string command = argv[1];
+    if (command == "render")
+    {
+        options.command = Command::Render;
+    }
+    else if (command == "resave")
+    {
+        options.command = Command::Resave;
+    }
+    else if (command == "info")
+    {
+        options.command = Command::Info;
+    }
+    else
+    {
+        fprintf(stderr, "Unknown command: %s\n\n%s", command.c_str(), USAGE);
+        return false;
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--overwrite")
+        {
+            options.overwrite = true;
+        }
+        else if (arg == "--strict")
+        {
+            options.limits = SmfLimits::strict();
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1) && !has_value)
+        {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        else if ((arg == "-o") || (arg == "--output"))
+        {
+            options.output_dir = argv[++i];
+        }
+        else if (arg == "-j")
+        {
+            options.jobs = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--soundfont")
+        {
+            options.soundfont = argv[++i];
+        }
+        else if (arg == "--type")
+        {
+            options.type = argv[++i];
+        }
+        else if (arg == "--sample-rate")
+        {
+            options.sample_rate = atof(argv[++i]);
+        }
+        else if (arg == "--bit-depth")
+        {
+            options.bit_depth = argv[++i];
+        }
+        else if (arg == "--interpolation")
+        {
+            options.interpolation = atoi(argv[++i]);
+        }
+        else if ((arg[0] == '-') && (arg.size() > 1))
+        {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return false;
+        }
+        else
+        {
+            options.files.push_back(arg);
+        }
+    }
+
+    if (options.files.empty())
+    {
+        fputs("No input files\n", stderr);
+        return false;
+    }
+    if ((options.command == Command::Render) && options.soundfont.empty())
+    {
+        fputs("render needs a SoundFont, pass --soundfont <path>\n", stderr);
+        return false;
+    }
+    if ((options.sample_rate < 8000.0) || (options.sample_rate > 96000.0))
+    {
+        fputs("Sample rate must be between 8000 and 96000\n", stderr);
+        return false;
+    }
+    if ((options.command == Command::Resave) && options.output_dir.empty() && !options.overwrite)
+    {
+        fputs("resave needs an output directory, or --overwrite to replace the input files\n", stderr);
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        return 2;
+    }
+
+    if (options.command == Command::Render)
+    {
+        // Failures are reported per file, keep FluidSynth warnings out of the output
+        fluid_set_log_function(FLUID_WARN, nullptr, nullptr);
+    }
+
+    // Workers take the next file until all are done
+    std::vector<Job> jobs(options.files.size());
+    std::atomic<size_t> next_file(0);
+    auto worker = [&options, &jobs, &next_file]()
+    {
+        for (size_t i = next_file++; i < options.files.size(); i = next_file++)
+        {
+            switch (options.command)
+            {
+                case Command::Render:
+                    render(options, options.files[i], jobs[i]);
+                    break;
+                case Command::Resave:
+                    resave(options, options.files[i], jobs[i]);
+                    break;
+                case Command::Info:
+                    info(options, options.files[i], jobs[i]);
+                    break;
+            }
+        }
+    };
+
+    size_t thread_count = std::min<size_t>(options.jobs, options.files.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!jobs[i].error.empty())
+        {
+            fprintf(stderr, "%s: %s\n", options.files[i].c_str(), jobs[i].error.c_str());
+            ++failed;
+        }
+        if (!jobs[i].output.empty())
+        {
+            puts(jobs[i].output.c_str());
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}